@@ -0,0 +1,202 @@
+/*
+MIT License
+
+Copyright (c) 2022 Danis Ozdemir
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// Throughput and latency of spsc_channel against a mutex protected
+// std::queue of results. Throughput streams results from one thread to
+// another, 1% of them errors. Latency bounces a single result between
+// two threads and reports the round trip percentiles.
+
+#include <cpp_channels.h>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <optional>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace {
+const std::size_t throughput_items = 5000000;
+const std::size_t latency_rounds = 100000;
+const std::size_t capacity = 1024;
+
+typedef std::chrono::steady_clock bench_clock;
+
+// The baseline every pipeline stage used before spsc_channel.
+template <typename T>
+class mutex_queue {
+ public:
+  void push(results::result<T>&& r) {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_queue.push(std::move(r));
+    }
+    m_cv.notify_one();
+  }
+
+  void close() {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_closed = true;
+    }
+    m_cv.notify_one();
+  }
+
+  std::optional<results::result<T>> pop() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_cv.wait(lock, [this] { return !m_queue.empty() || m_closed; });
+    if (m_queue.empty()) {
+      return std::nullopt;
+    }
+    std::optional<results::result<T>> r(std::move(m_queue.front()));
+    m_queue.pop();
+    return r;
+  }
+
+ private:
+  std::mutex m_mutex;
+  std::condition_variable m_cv;
+  std::queue<results::result<T>> m_queue;
+  bool m_closed = false;
+};
+
+results::result<std::uint64_t> make_item(std::uint64_t i) {
+  if (i % 100 == 99) {
+    return results::result<std::uint64_t>(errors::make_error("item %lu failed", i));
+  }
+  return results::result<std::uint64_t>(std::move(i));
+}
+
+template <typename Channel>
+double throughput(Channel& ch) {
+  auto start = bench_clock::now();
+  std::thread producer([&ch] {
+    for (std::uint64_t i = 0; i < throughput_items; i++) {
+      ch.push(make_item(i));
+    }
+    ch.close();
+  });
+
+  std::size_t seen = 0;
+  while (auto r = ch.pop()) {
+    if (auto err = r->error(); !err) {
+      r->value();
+    }
+    seen++;
+  }
+  producer.join();
+
+  std::chrono::duration<double> elapsed = bench_clock::now() - start;
+  return seen / elapsed.count();
+}
+
+template <typename Channel>
+double batched_throughput(Channel& ch) {
+  const std::size_t batch = 64;
+  auto start = bench_clock::now();
+  std::thread producer([&ch] {
+    std::vector<results::result<std::uint64_t>> items;
+    for (std::uint64_t i = 0; i < throughput_items; i += batch) {
+      items.clear();
+      for (std::uint64_t j = i; j < i + batch && j < throughput_items; j++) {
+        items.push_back(make_item(j));
+      }
+      ch.push_batch(items.begin(), items.size());
+    }
+    ch.close();
+  });
+
+  std::size_t seen = 0;
+  std::vector<results::result<std::uint64_t>> items;
+  while (true) {
+    items.clear();
+    std::size_t n = ch.pop_batch(std::back_inserter(items), batch);
+    if (n == 0) {
+      break;
+    }
+    seen += n;
+  }
+  producer.join();
+
+  std::chrono::duration<double> elapsed = bench_clock::now() - start;
+  return seen / elapsed.count();
+}
+
+template <typename Channel>
+void latency(const char* name) {
+  Channel ping, pong;
+  std::vector<double> samples;
+  samples.reserve(latency_rounds);
+
+  std::thread echo([&ping, &pong] {
+    while (auto r = ping.pop()) {
+      pong.push(std::move(*r));
+    }
+  });
+
+  for (std::uint64_t i = 0; i < latency_rounds; i++) {
+    auto start = bench_clock::now();
+    ping.push(results::result<std::uint64_t>(std::move(i)));
+    pong.pop();
+    std::chrono::duration<double, std::nano> elapsed = bench_clock::now() - start;
+    samples.push_back(elapsed.count());
+  }
+  ping.close();
+  echo.join();
+
+  std::sort(samples.begin(), samples.end());
+  printf("%-28s round trip p50 %8.0f ns  p99 %8.0f ns  p999 %8.0f ns\n", name, samples[samples.size() / 2],
+         samples[samples.size() * 99 / 100], samples[samples.size() * 999 / 1000]);
+}
+}  // namespace
+
+int main() {
+  typedef results::spsc_channel<std::uint64_t, capacity, results::spin_wait> spinning_channel;
+  typedef results::spsc_channel<std::uint64_t, capacity, results::blocking_wait> blocking_channel;
+
+  {
+    mutex_queue<std::uint64_t> q;
+    printf("%-28s %12.0f results/s\n", "mutex queue", throughput(q));
+  }
+  {
+    auto ch = std::make_unique<spinning_channel>();
+    printf("%-28s %12.0f results/s\n", "spsc channel (spinning)", throughput(*ch));
+  }
+  {
+    auto ch = std::make_unique<blocking_channel>();
+    printf("%-28s %12.0f results/s\n", "spsc channel (blocking)", throughput(*ch));
+  }
+  {
+    auto ch = std::make_unique<spinning_channel>();
+    printf("%-28s %12.0f results/s\n", "spsc channel (batched)", batched_throughput(*ch));
+  }
+
+  latency<mutex_queue<std::uint64_t>>("mutex queue");
+  latency<spinning_channel>("spsc channel (spinning)");
+  latency<blocking_channel>("spsc channel (blocking)");
+  return 0;
+}
@@ -0,0 +1,53 @@
+/*
+MIT License
+
+Copyright (c) 2022 Danis Ozdemir
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// Time of the success path of parse_endpoint, linked against whichever
+// build of caller.cpp the Makefile picks.
+
+#include <chrono>
+#include <cstdio>
+#include "caller.h"
+
+namespace {
+const int iterations = 10000000;
+
+typedef std::chrono::steady_clock bench_clock;
+}  // namespace
+
+int main(int argc, char** argv) {
+  const char* text = "backend-01.example.com:8080/25";
+  std::size_t sink = 0;
+  auto start = bench_clock::now();
+  for (int i = 0; i < iterations; i++) {
+    auto r = parse_endpoint(text);
+    if (auto err = r.error(); err) {
+      fprintf(stderr, "%s\n", err->cmessage());
+      return 1;
+    }
+    sink += r.value().port;
+  }
+  std::chrono::duration<double, std::nano> elapsed = bench_clock::now() - start;
+  printf("%-12s %8.1f ns per successful call (%zu)\n", argc > 1 ? argv[1] : "", elapsed.count() / iterations, sink % 10);
+  return 0;
+}
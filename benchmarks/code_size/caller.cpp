@@ -0,0 +1,91 @@
+/*
+MIT License
+
+Copyright (c) 2022 Danis Ozdemir
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// A typical caller of the library: parsing "host:port/weight" into an
+// endpoint, with an error path next to every step of the success path.
+// It's compiled once with the error paths marked cold and once with
+// CPP_ERRORS_NO_COLD, and the Makefile compares the two.
+
+#include <cpp_errors.h>
+#include <cpp_results.h>
+#include "caller.h"
+
+namespace {
+results::result<int> parse_number(const char*& s, char end, int min, int max) {
+  if (*s == end) {
+    return results::result<int>(errors::make_terror(errors::err_type::invalid_argument, "missing number"));
+  }
+
+  int value = 0;
+  for (; *s != end; ++s) {
+    if (*s < '0' || *s > '9') {
+      return results::result<int>(
+          errors::make_terror(errors::err_type::invalid_argument, "unexpected character '%c' in a number", *s));
+    }
+    value = value * 10 + (*s - '0');
+    if (value > max) {
+      return results::result<int>(
+          errors::make_terror(errors::err_type::result_out_of_range, "number is larger than %d", max));
+    }
+  }
+
+  if (value < min) {
+    return results::result<int>(
+        errors::make_terror(errors::err_type::result_out_of_range, "%d is smaller than %d", value, min));
+  }
+  return results::result<int>(std::move(value));
+}
+}  // namespace
+
+results::result<endpoint> parse_endpoint(const char* text) {
+  endpoint out;
+  const char* s = text;
+  std::size_t length = 0;
+  for (; *s != ':'; ++s) {
+    if (*s == '\0') {
+      return results::result<endpoint>(errors::make_terror(errors::err_type::invalid_argument, "no port in \"%s\"", text));
+    }
+    if (length + 1 == sizeof(out.host)) {
+      return results::result<endpoint>(
+          errors::make_terror(errors::err_type::filename_too_long, "host name too long in \"%s\"", text));
+    }
+    out.host[length++] = *s;
+  }
+  out.host[length] = '\0';
+
+  auto port = parse_number(++s, '/', 1, 65535);
+  if (auto err = port.error(); err) {
+    err->append("while parsing the port of \"%s\"", text);
+    return results::result<endpoint>(std::move(err));
+  }
+  out.port = port.value();
+
+  auto weight = parse_number(++s, '\0', 0, 100);
+  if (auto err = weight.error(); err) {
+    err->append("while parsing the weight of \"%s\"", text);
+    return results::result<endpoint>(std::move(err));
+  }
+  out.weight = weight.value();
+  return results::result<endpoint>(std::move(out));
+}
@@ -0,0 +1,402 @@
+/*
+MIT License
+
+Copyright (c) 2022 Danis Ozdemir
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// error_storm is a load generator for the tail latency of the library
+// under contention. Every thread pushes requests through a pipeline of
+// stages returning results::result. A configurable share of them fail
+// at the deepest stage, and every stage on the way back appends its
+// context, so a failed request carries a chain of depth couples. The
+// latency of the successful and the failed requests is reported
+// separately, together with their allocations and the memory held by
+// malloc, e.g.
+//
+// ./benchmark -t 64 -r 5 -d 8 -m 64
+//
+// -s sets a soft memory limit, which turns the accounting of the memory
+// held by errors on (-s 0 leaves it off, the default), so that its cost
+// can be compared and its numbers get reported too.
+
+#include <cpp_errors.h>
+#include <cpp_results.h>
+#include <malloc.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <thread>
+#include <vector>
+
+namespace {
+typedef std::chrono::steady_clock bench_clock;
+
+struct config {
+  unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+  std::size_t requests = 100000;
+  double failure_rate = 0.05;
+  unsigned depth = 8;
+  int message_size = 64;
+  unsigned work = 50;
+  std::size_t soft_limit = 0;
+};
+
+struct allocation_counts {
+  std::size_t allocations = 0;
+  std::size_t bytes = 0;
+};
+
+thread_local allocation_counts thread_counts;
+
+// histogram keeps latencies in buckets of 32 per power of two, so the
+// percentiles are within about 3% of the exact ones without storing
+// every sample.
+class histogram {
+  static const int sub_buckets = 32;
+  static const int sub_bucket_bits = 5;
+
+ public:
+  histogram() : m_counts(64 * sub_buckets) {}
+
+  void record(std::uint64_t ns) {
+    m_counts[index(ns)]++;
+    m_total++;
+    m_max = std::max(m_max, ns);
+  }
+
+  void merge(const histogram& other) {
+    for (std::size_t i = 0; i < m_counts.size(); i++) {
+      m_counts[i] += other.m_counts[i];
+    }
+    m_total += other.m_total;
+    m_max = std::max(m_max, other.m_max);
+  }
+
+  // The function percentile returns the upper bound of the bucket
+  // holding the p-th fraction of the samples.
+  std::uint64_t percentile(double p) const {
+    std::uint64_t rank = static_cast<std::uint64_t>(p * m_total);
+    std::uint64_t seen = 0;
+    for (std::size_t i = 0; i < m_counts.size(); i++) {
+      seen += m_counts[i];
+      if (seen > rank) {
+        return std::min(upper_bound(i), m_max);
+      }
+    }
+    return m_max;
+  }
+
+  std::uint64_t total() const { return m_total; }
+  std::uint64_t max() const { return m_max; }
+
+ private:
+  static std::size_t index(std::uint64_t ns) {
+    if (ns < sub_buckets) {
+      return ns;
+    }
+    int exponent = 63 - __builtin_clzll(ns);
+    int shift = exponent - sub_bucket_bits;
+    return (shift + 1) * sub_buckets + ((ns >> shift) - sub_buckets);
+  }
+
+  static std::uint64_t upper_bound(std::size_t index) {
+    if (index < sub_buckets) {
+      return index;
+    }
+    int shift = index / sub_buckets - 1;
+    std::uint64_t mantissa = index % sub_buckets + sub_buckets;
+    return ((mantissa + 1) << shift) - 1;
+  }
+
+  std::vector<std::uint64_t> m_counts;
+  std::uint64_t m_total = 0;
+  std::uint64_t m_max = 0;
+};
+
+// path_report holds what the requests of one path, succeeded or
+// failed, cost.
+struct path_report {
+  histogram latency;
+  allocation_counts allocations;
+
+  void merge(const path_report& other) {
+    latency.merge(other.latency);
+    allocations.allocations += other.allocations.allocations;
+    allocations.bytes += other.allocations.bytes;
+  }
+};
+
+struct thread_report {
+  path_report success;
+  path_report failure;
+  std::uint64_t sink = 0;
+};
+
+struct request {
+  std::uint64_t id;
+  std::uint64_t state;
+};
+
+const char padding[] =
+    "................................................................................................................"
+    "................................................................................................................"
+    "................................................................................................................"
+    "................................................................................................................";
+
+// The function work stands in for what a stage does with a request.
+std::uint64_t work(std::uint64_t state, unsigned rounds) {
+  for (unsigned i = 0; i < rounds; i++) {
+    state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+    state ^= state >> 33;
+  }
+  return state;
+}
+
+__attribute__((noinline)) results::result<request> run_stage(const config& c, request req, unsigned stage, bool fail) {
+  req.state = work(req.state, c.work);
+  if (stage + 1 >= c.depth) {
+    if (fail) {
+      return results::result<request>(errors::make_terror(errors::err_type::resource_unavailable_try_again,
+                                                          "request %lu failed: %.*s", req.id, c.message_size, padding));
+    }
+    return results::result<request>(std::move(req));
+  }
+
+  results::result<request> r = run_stage(c, req, stage + 1, fail);
+  if (auto err = r.error(); err) {
+    err->append("in stage %u of request %lu: %.*s", stage, req.id, c.message_size, padding);
+    return results::result<request>(std::move(err));
+  }
+  return r;
+}
+
+void run_worker(const config& c, unsigned index, const std::atomic<bool>& start, thread_report& out) {
+  std::uint64_t random = 0x9e3779b97f4a7c15ULL * (index + 1);
+  const std::uint64_t failure_threshold = static_cast<std::uint64_t>(c.failure_rate * 1000000);
+  while (!start.load(std::memory_order_acquire)) {
+    std::this_thread::yield();
+  }
+
+  for (std::size_t i = 0; i < c.requests; i++) {
+    random ^= random << 13;
+    random ^= random >> 7;
+    random ^= random << 17;
+    const bool fail = random % 1000000 < failure_threshold;
+
+    allocation_counts before = thread_counts;
+    auto begin = bench_clock::now();
+    {
+      results::result<request> r = run_stage(c, request{i, random}, 0, fail);
+      if (auto err = r.error(); err) {
+        out.sink += err->couples().size() + errors::is_retryable(err);
+      } else {
+        out.sink += r.value().state;
+      }
+    }
+    std::chrono::nanoseconds elapsed = bench_clock::now() - begin;
+
+    path_report& path = fail ? out.failure : out.success;
+    path.latency.record(elapsed.count());
+    path.allocations.allocations += thread_counts.allocations - before.allocations;
+    path.allocations.bytes += thread_counts.bytes - before.bytes;
+  }
+}
+
+void print_path(const char* name, const path_report& path) {
+  std::uint64_t n = path.latency.total();
+  printf("%-8s %10lu %9lu %9lu %9lu %9lu %11.2f %11.1f\n", name, n, path.latency.percentile(0.5),
+         path.latency.percentile(0.99), path.latency.percentile(0.999), path.latency.max(),
+         n ? double(path.allocations.allocations) / n : 0.0, n ? double(path.allocations.bytes) / n : 0.0);
+}
+
+// malloc_usage is what glibc's malloc holds in all of its arenas.
+// mallinfo2 only reports the main arena, while the threads mostly
+// allocate from arenas of their own, so the totals of malloc_info are
+// used instead.
+struct malloc_usage {
+  std::size_t arenas = 0;
+  std::size_t system = 0;
+  std::size_t mmapped = 0;
+  std::size_t free = 0;
+};
+
+malloc_usage get_malloc_usage() {
+  malloc_usage memory;
+  char* xml = nullptr;
+  std::size_t size = 0;
+  FILE* stream = open_memstream(&xml, &size);
+  if (stream == nullptr) {
+    return memory;
+  }
+  const bool written = malloc_info(0, stream) == 0;
+  fclose(stream);
+
+  // Every arena is a <heap>, the totals of all of them come after the
+  // last one, one element per line.
+  const char* totals = written ? xml : nullptr;
+  for (const char* heap = totals; heap != nullptr && (heap = strstr(heap, "</heap>")) != nullptr; heap++) {
+    memory.arenas++;
+    totals = heap;
+  }
+  for (const char* line = totals; line != nullptr && *line != '\0'; line = strchr(line, '\n')) {
+    line += *line == '\n';
+    char type[16];
+    std::size_t bytes;
+    if (sscanf(line, "<total type=\"%15[a-z]\" count=\"%*u\" size=\"%zu\"/>", type, &bytes) == 2) {
+      if (strcmp(type, "mmap") == 0) {
+        memory.mmapped = bytes;
+      } else {
+        memory.free += bytes;
+      }
+    } else if (sscanf(line, "<system type=\"current\" size=\"%zu\"/>", &bytes) == 1) {
+      memory.system = bytes;
+    }
+  }
+  free(xml);
+  return memory;
+}
+
+void usage(const char* program) {
+  fprintf(stderr,
+          "usage: %s [-t threads] [-n requests per thread] [-r failure rate in %%] [-d chain depth]\n"
+          "          [-m message size] [-w work rounds per stage] [-s soft memory limit in bytes]\n",
+          program);
+  exit(2);
+}
+}  // namespace
+
+// Only operator new is counted, which is what the library allocates
+// with. The counters are per thread, so counting doesn't add contention
+// of its own.
+__attribute__((noinline)) void* operator new(std::size_t size) {
+  thread_counts.allocations++;
+  thread_counts.bytes += size;
+  void* p = malloc(size ? size : 1);
+  if (p == nullptr) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+__attribute__((noinline)) void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+  thread_counts.allocations++;
+  thread_counts.bytes += size;
+  return malloc(size ? size : 1);
+}
+
+__attribute__((noinline)) void operator delete(void* p) noexcept { free(p); }
+
+__attribute__((noinline)) void operator delete(void* p, std::size_t) noexcept { free(p); }
+
+int main(int argc, char** argv) {
+  config c;
+  for (int option; (option = getopt(argc, argv, "t:n:r:d:m:w:s:")) != -1;) {
+    switch (option) {
+      case 't':
+        c.threads = std::max(1, atoi(optarg));
+        break;
+      case 'n':
+        c.requests = std::max(1L, atol(optarg));
+        break;
+      case 'r':
+        c.failure_rate = std::clamp(atof(optarg), 0.0, 100.0) / 100;
+        break;
+      case 'd':
+        c.depth = std::max(1, atoi(optarg));
+        break;
+      case 'm':
+        c.message_size = std::clamp(atoi(optarg), 0, static_cast<int>(sizeof(padding) - 1));
+        break;
+      case 'w':
+        c.work = std::max(0, atoi(optarg));
+        break;
+      case 's':
+        c.soft_limit = strtoull(optarg, nullptr, 10);
+        break;
+      default:
+        usage(argv[0]);
+    }
+  }
+
+  printf("%u threads, %zu requests per thread, %.2f%% failing, chain depth %u, message size %d, work %u\n\n",
+         c.threads, c.requests, c.failure_rate * 100, c.depth, c.message_size, c.work);
+  errors::set_soft_memory_limit(c.soft_limit);
+
+  std::vector<thread_report> reports(c.threads);
+  std::vector<std::thread> threads;
+  std::atomic<bool> start{false};
+  std::atomic<unsigned> finished{0};
+  for (unsigned i = 0; i < c.threads; i++) {
+    threads.emplace_back([&c, i, &start, &finished, &reports] {
+      run_worker(c, i, start, reports[i]);
+      finished.fetch_add(1, std::memory_order_release);
+    });
+  }
+
+  // The peaks of the memory held by errors are sampled while the
+  // workers run.
+  std::size_t peak_errors = 0;
+  std::size_t peak_bytes = 0;
+  auto begin = bench_clock::now();
+  start.store(true, std::memory_order_release);
+  while (finished.load(std::memory_order_acquire) < c.threads) {
+    errors::error_memory_stats stats = errors::memory_stats();
+    peak_errors = std::max(peak_errors, stats.live_errors);
+    peak_bytes = std::max(peak_bytes, stats.live_bytes);
+    std::this_thread::sleep_for(std::chrono::microseconds(100));
+  }
+  std::chrono::duration<double> elapsed = bench_clock::now() - begin;
+  for (std::thread& t : threads) {
+    t.join();
+  }
+
+  thread_report total;
+  for (const thread_report& report : reports) {
+    total.success.merge(report.success);
+    total.failure.merge(report.failure);
+    total.sink += report.sink;
+  }
+
+  printf("%-8s %10s %9s %9s %9s %9s %11s %11s\n", "path", "requests", "p50 ns", "p99 ns", "p999 ns", "max ns",
+         "allocs/req", "bytes/req");
+  print_path("success", total.success);
+  print_path("failure", total.failure);
+
+  std::uint64_t requests = total.success.latency.total() + total.failure.latency.total();
+  printf("\nthroughput %.0f requests/s (%lu)\n", requests / elapsed.count(), total.sink % 10);
+
+  if (c.soft_limit != 0) {
+    errors::error_memory_stats stats = errors::memory_stats();
+    printf("errors     peak %zu live errors, peak %zu live bytes, %zu live now, %zu couples degraded, %zu dropped\n",
+           peak_errors, peak_bytes, stats.live_errors, stats.degraded_couples, stats.dropped_couples);
+  }
+
+  malloc_usage memory = get_malloc_usage();
+  printf("malloc     %zu bytes in %zu arenas, %zu in mmapped blocks, %zu in use, %zu free\n", memory.system,
+         memory.arenas, memory.mmapped, memory.system - memory.free, memory.free);
+  return 0;
+}
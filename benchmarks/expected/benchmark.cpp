@@ -0,0 +1,127 @@
+/*
+MIT License
+
+Copyright (c) 2022 Danis Ozdemir
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// Cost of passing values through std::expected, through results::result
+// and through result_pair, and of converting between them at an API
+// boundary. The conversions move the payload once, so the converted
+// paths should stay within noise of the native ones.
+
+#include <cpp_results.h>
+#include <chrono>
+#include <cstdio>
+#include <expected>
+#include <string>
+
+namespace {
+const int iterations = 10000000;
+
+typedef std::chrono::steady_clock bench_clock;
+
+// payload is moved around but never copied.
+struct payload {
+  std::string name;
+  long values[4];
+};
+
+template <typename F>
+void measure(const char* name, F f) {
+  std::size_t sink = 0;
+  auto start = bench_clock::now();
+  for (int i = 0; i < iterations; i++) {
+    sink += f(i);
+  }
+  std::chrono::duration<double, std::nano> elapsed = bench_clock::now() - start;
+  printf("%-36s %8.2f ns per call (%zu)\n", name, elapsed.count() / iterations, sink % 10);
+}
+
+__attribute__((noinline)) payload produce(int i) {
+  return payload{"a name which does not fit inline", {i, i + 1, i + 2, i + 3}};
+}
+
+__attribute__((noinline)) std::expected<payload, errors::error> native_expected(int i) {
+  if (i < 0) {
+    return std::unexpected(errors::make_error("negative %d", i));
+  }
+  return produce(i);
+}
+
+__attribute__((noinline)) results::result<payload> native_result(int i) {
+  if (i < 0) {
+    return results::result<payload>(errors::make_error("negative %d", i));
+  }
+  return results::result<payload>(produce(i));
+}
+
+__attribute__((noinline)) results::result_pair<payload> native_pair(int i) {
+  if (i < 0) {
+    return results::result_pair<payload>(errors::make_error("negative %d", i));
+  }
+  return results::result_pair<payload>(produce(i));
+}
+
+__attribute__((noinline)) std::expected<payload, errors::error> result_as_expected(int i) {
+  return native_result(i).to_expected();
+}
+
+__attribute__((noinline)) results::result<payload> expected_as_result(int i) {
+  return results::result<payload>(native_expected(i));
+}
+
+__attribute__((noinline)) results::result_pair<payload> expected_as_pair(int i) {
+  return results::result_pair<payload>(native_expected(i));
+}
+}  // namespace
+
+int main() {
+  measure("std::expected", [](int i) {
+    auto e = native_expected(i);
+    return e ? e->values[3] : 0;
+  });
+
+  measure("results::result", [](int i) {
+    auto r = native_result(i);
+    return r.error() ? 0 : r.value().values[3];
+  });
+
+  measure("results::result_pair", [](int i) {
+    auto [value, err] = native_pair(i);
+    return err ? 0 : value.values[3];
+  });
+
+  measure("result converted to std::expected", [](int i) {
+    auto e = result_as_expected(i);
+    return e ? e->values[3] : 0;
+  });
+
+  measure("std::expected converted to result", [](int i) {
+    auto r = expected_as_result(i);
+    return r.error() ? 0 : r.value().values[3];
+  });
+
+  measure("std::expected converted to pair", [](int i) {
+    auto [value, err] = expected_as_pair(i);
+    return err ? 0 : value.values[3];
+  });
+  return 0;
+}
@@ -0,0 +1,82 @@
+/*
+MIT License
+
+Copyright (c) 2022 Danis Ozdemir
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// Cost of attaching context to an error as fields, against formatting
+// the same data into the message. Fields pay for formatting only when
+// they get rendered, so both the creation alone and the creation plus
+// a JSON rendering are measured.
+
+#include <cpp_errors.h>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+namespace {
+const int iterations = 1000000;
+
+typedef std::chrono::steady_clock bench_clock;
+
+template <typename F>
+void measure(const char* name, F f) {
+  std::size_t sink = 0;
+  auto start = bench_clock::now();
+  for (int i = 0; i < iterations; i++) {
+    sink += f(i);
+  }
+  std::chrono::duration<double, std::nano> elapsed = bench_clock::now() - start;
+  printf("%-36s %8.1f ns per error (%zu)\n", name, elapsed.count() / iterations, sink % 10);
+}
+}  // namespace
+
+int main() {
+  const char* path = "/var/lib/data/0001";
+
+  measure("message with formatted context", [path](int i) {
+    errors::error err = errors::make_terror(errors::err_type::io_error, "read failed id=%d size=%llu path=%s ratio=%f", i,
+                                            static_cast<unsigned long long>(i) * 4096, path, i / 3.0);
+    return err->message().size();
+  });
+
+  measure("message and fields", [path](int i) {
+    errors::error err = errors::make_terror(errors::err_type::io_error, "read failed");
+    err->add_field("id", i).add_field("size", std::uint64_t(i) * 4096).add_field("path", path).add_field("ratio", i / 3.0);
+    return err->fields().size();
+  });
+
+  measure("message and fields, rendered as JSON", [path](int i) {
+    errors::error err = errors::make_terror(errors::err_type::io_error, "read failed");
+    err->add_field("id", i).add_field("size", std::uint64_t(i) * 4096).add_field("path", path).add_field("ratio", i / 3.0);
+    return err->fields_json().size();
+  });
+
+  measure("message and fields, visited", [path](int i) {
+    errors::error err = errors::make_terror(errors::err_type::io_error, "read failed");
+    err->add_field("id", i).add_field("size", std::uint64_t(i) * 4096).add_field("path", path).add_field("ratio", i / 3.0);
+    std::size_t keys = 0;
+    err->visit_fields([&keys](const char* key, auto) { keys += key[0]; });
+    return keys;
+  });
+  return 0;
+}
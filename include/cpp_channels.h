@@ -0,0 +1,308 @@
+/*
+MIT License
+
+Copyright (c) 2022 Danis Ozdemir
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include <cpp_errors.h>
+#include <cpp_results.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <iterator>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <thread>
+#include <utility>
+
+namespace results {
+// The assumed size of a cache line. The producer and the consumer
+// indices are kept on separate lines to avoid false sharing.
+inline constexpr std::size_t channel_cache_line_size = 64;
+
+// The function __cpu_relax is a hint to the processor that the
+// caller is busy waiting.
+inline void __cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__)
+  asm volatile("yield" ::: "memory");
+#else
+  std::this_thread::yield();
+#endif
+}
+
+// spin_wait is a wait strategy for spsc_channel which never sleeps.
+// It gives the lowest latency, at the cost of burning a core while
+// waiting. notify is free.
+class spin_wait {
+ public:
+  template <typename Pred>
+  void wait(Pred ready) {
+    for (unsigned spins = 0; !ready(); ++spins) {
+      if (spins < 1024) {
+        __cpu_relax();
+      } else {
+        std::this_thread::yield();
+      }
+    }
+  }
+
+  void notify() {}
+};
+
+// blocking_wait is a wait strategy for spsc_channel which spins for a
+// short while and then sleeps on a condition variable. notify only
+// touches the mutex when the other side is actually asleep, so an
+// uncontended channel does not pay for it.
+class blocking_wait {
+ public:
+  template <typename Pred>
+  void wait(Pred ready) {
+    for (unsigned spins = 0; spins < 256; ++spins) {
+      if (ready()) {
+        return;
+      }
+      __cpu_relax();
+    }
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_sleepers.fetch_add(1, std::memory_order_seq_cst);
+    m_cv.wait(lock, ready);
+    m_sleepers.fetch_sub(1, std::memory_order_relaxed);
+  }
+
+  void notify() {
+    // Pairs with the fetch_add in wait: either the sleeper sees the
+    // published index or we see the sleeper.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (m_sleepers.load(std::memory_order_relaxed) > 0) {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_cv.notify_all();
+    }
+  }
+
+ private:
+  std::mutex m_mutex;
+  std::condition_variable m_cv;
+  std::atomic<int> m_sleepers{0};
+};
+
+// spsc_channel is a bounded, lock-free ring buffer of result<T> objects
+// for exactly one producer thread and exactly one consumer thread.
+// Results are moved into and out of preallocated slots, so neither the
+// values nor the error pointers cause any allocation in the channel.
+// Capacity has to be a power of two. A simple use case would look like
+// the following code block:
+//
+// results::spsc_channel<int, 1024> ch;
+//
+// // producer thread
+// ch.push(results::result<int>(42));
+// ch.close(errors::make_error("upstream went away"));
+//
+// // consumer thread
+// while (auto r = ch.pop()) {
+//   if (auto err = r->error(); err) {
+//     // Either a regular error or the terminal error given to close
+//     break;
+//   }
+//   consume(r->value());
+// }
+template <typename T, std::size_t Capacity, typename WaitStrategy = spin_wait>
+class spsc_channel {
+  static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "Capacity should be a power of two");
+
+ public:
+  spsc_channel() = default;
+  spsc_channel(const spsc_channel&) = delete;
+  spsc_channel& operator=(const spsc_channel&) = delete;
+
+  ~spsc_channel() {
+    std::size_t head = m_head.load(std::memory_order_relaxed);
+    std::size_t tail = m_tail.load(std::memory_order_relaxed);
+    for (; head != tail; ++head) {
+      slot(head)->~result<T>();
+    }
+  }
+
+  // The function try_push moves r into the channel, if there is room
+  // for it. r is left untouched when the function returns false.
+  // Producer side only.
+  bool try_push(result<T>&& r) { return try_push_batch(&r, 1) == 1; }
+
+  // The function push moves r into the channel, waiting for room if
+  // the channel is full. Producer side only.
+  void push(result<T>&& r) { push_batch(&r, 1); }
+
+  // The function try_push_batch moves up to n results starting from
+  // first into the channel, publishing them with a single store. It
+  // returns how many were moved. Producer side only.
+  template <typename InputIt>
+  std::size_t try_push_batch(InputIt first, std::size_t n) {
+    std::size_t tail = m_tail.load(std::memory_order_relaxed);
+    std::size_t room = Capacity - (tail - m_cached_head);
+    if (room < n) {
+      m_cached_head = m_head.load(std::memory_order_acquire);
+      room = Capacity - (tail - m_cached_head);
+    }
+
+    std::size_t count = n < room ? n : room;
+    for (std::size_t i = 0; i < count; ++i, ++first) {
+      new (slot(tail + i)) result<T>(std::move(*first));
+    }
+
+    if (count > 0) {
+      m_tail.store(tail + count, std::memory_order_release);
+      m_not_empty.notify();
+    }
+    return count;
+  }
+
+  // The function push_batch moves all n results starting from first
+  // into the channel, waiting for room whenever the channel is full.
+  // Producer side only.
+  template <typename InputIt>
+  void push_batch(InputIt first, std::size_t n) {
+    while (n > 0) {
+      std::size_t count = try_push_batch(first, n);
+      std::advance(first, count);
+      n -= count;
+      if (n > 0) {
+        m_not_full.wait([this] {
+          return m_tail.load(std::memory_order_relaxed) - m_head.load(std::memory_order_acquire) < Capacity;
+        });
+      }
+    }
+  }
+
+  // The function close marks the end of the stream. If err is not
+  // nullptr, the consumer receives it as a final result<T> once it
+  // has drained everything pushed before. Producer side only, and
+  // nothing may be pushed after it.
+  void close(errors::error&& err = nullptr) {
+    m_terminal_error = std::move(err);
+    m_closed.store(true, std::memory_order_release);
+    m_not_empty.notify();
+  }
+
+  // The function try_pop returns the oldest result in the channel, or
+  // std::nullopt if there is none at the moment. Consumer side only.
+  std::optional<result<T>> try_pop() {
+    std::optional<result<T>> out;
+    try_pop_batch(&out, 1);
+    return out;
+  }
+
+  // The function pop waits for a result and returns it. It returns
+  // std::nullopt only after the channel was closed and every result,
+  // including the terminal error, has been handed out. Consumer side
+  // only.
+  std::optional<result<T>> pop() {
+    std::optional<result<T>> out;
+    pop_batch(&out, 1);
+    return out;
+  }
+
+  // The function try_pop_batch moves up to max results out of the
+  // channel into out, releasing their slots with a single store. It
+  // returns how many were moved. Consumer side only.
+  template <typename OutputIt>
+  std::size_t try_pop_batch(OutputIt out, std::size_t max) {
+    std::size_t head = m_head.load(std::memory_order_relaxed);
+    std::size_t available = m_cached_tail - head;
+    if (available < max) {
+      m_cached_tail = m_tail.load(std::memory_order_acquire);
+      available = m_cached_tail - head;
+    }
+
+    std::size_t count = max < available ? max : available;
+    for (std::size_t i = 0; i < count; ++i, ++out) {
+      result<T>* r = slot(head + i);
+      *out = std::move(*r);
+      r->~result<T>();
+    }
+
+    if (count > 0) {
+      m_head.store(head + count, std::memory_order_release);
+      m_not_full.notify();
+      return count;
+    }
+
+    if (max > 0 && drained()) {
+      if (errors::error err = std::move(m_terminal_error); err) {
+        *out = result<T>(std::move(err));
+        return 1;
+      }
+    }
+    return 0;
+  }
+
+  // The function pop_batch waits until at least one result is
+  // available and then behaves like try_pop_batch. It returns 0 only
+  // when the channel is closed and fully drained. Consumer side only.
+  template <typename OutputIt>
+  std::size_t pop_batch(OutputIt out, std::size_t max) {
+    while (true) {
+      std::size_t count = try_pop_batch(out, max);
+      if (count > 0 || max == 0 || drained()) {
+        return count;
+      }
+      m_not_empty.wait([this] {
+        return m_tail.load(std::memory_order_acquire) != m_head.load(std::memory_order_relaxed) ||
+               m_closed.load(std::memory_order_acquire);
+      });
+    }
+  }
+
+  // The function closed reports whether the producer has called close.
+  bool closed() const { return m_closed.load(std::memory_order_acquire); }
+
+ private:
+  result<T>* slot(std::size_t index) {
+    return std::launder(reinterpret_cast<result<T>*>(&m_slots[(index & (Capacity - 1)) * sizeof(result<T>)]));
+  }
+
+  // Everything is pushed before close, so once close is visible the
+  // tail can no longer move.
+  bool drained() {
+    return m_closed.load(std::memory_order_acquire) &&
+           m_tail.load(std::memory_order_acquire) == m_head.load(std::memory_order_relaxed);
+  }
+
+  // Consumer owned line
+  alignas(channel_cache_line_size) std::atomic<std::size_t> m_head{0};
+  std::size_t m_cached_tail = 0;
+  WaitStrategy m_not_full;
+
+  // Producer owned line
+  alignas(channel_cache_line_size) std::atomic<std::size_t> m_tail{0};
+  std::size_t m_cached_head = 0;
+  WaitStrategy m_not_empty;
+  std::atomic<bool> m_closed{false};
+  errors::error m_terminal_error;
+
+  alignas(channel_cache_line_size) alignas(result<T>) unsigned char m_slots[Capacity * sizeof(result<T>)];
+};
+}  // namespace results
@@ -1,231 +1,1448 @@
-/*
-MIT License
-
-Copyright (c) 2022 Danis Ozdemir
-
-Permission is hereby granted, free of charge, to any person obtaining a copy
-of this software and associated documentation files (the "Software"), to deal
-in the Software without restriction, including without limitation the rights
-to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
-copies of the Software, and to permit persons to whom the Software is
-furnished to do so, subject to the following conditions:
-
-The above copyright notice and this permission notice shall be included in all
-copies or substantial portions of the Software.
-
-THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
-IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
-FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
-AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
-LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
-OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
-SOFTWARE.
-*/
-
-#pragma once
-
-#include <memory>
-#include <vector>
-#include <string>
-#include <cstdarg>
-#include <cstdio>
-
-#ifdef __DEFINE_ERROR_T
-#error __DEFINE_ERROR_T is defined elsewwhere
-#endif
-
-#ifdef __stringfy_err
-#error __stringfy_err is defined elsewhere
-#endif
-
-namespace errors {
-namespace {
-// The default max size for error message buffer
-const static std::size_t default_error_message_size = 1024;
-const static std::string static_default_message = "";
-}  // namespace
-
-// err_type enum encapsulates the types of errors.
-enum class err_type {
-#define __DEFINE_ERROR_T(e) e,
-#include <error_types/predefined_errors.h>
-#include <error_types/user_defined_errors.h>
-#undef __DEFINE_ERROR_T
-};
-
-// Function c_str returns a c-string describing
-// the err_type e, when it's given e as input
-// parameter.
-inline const char* c_str(err_type e) {
-  static const char* conversion_array[] = {
-#define __stringfy_err(a) #a
-#define __DEFINE_ERROR_T(e) __stringfy_err(e),
-#include <error_types/predefined_errors.h>
-#include <error_types/user_defined_errors.h>
-#undef __DEFINE_ERROR_T
-#undef __stringfy_err
-  };
-
-  return conversion_array[static_cast<int>(e)];
-}
-
-// Function str returns an std::string describing
-// the err_type e, when it's given e as input
-// parameter.
-inline std::string str(err_type e) {
-  std::string result = c_str(e);
-  return result;
-}
-
-// Forward declaration of __error to define error type.
-class __error;
-
-// 'error' is a std::unique_ptr that encapsulates a vector of
-// error couples and functions to modify them.
-typedef std::unique_ptr<__error> error;
-
-// Definition of 'error_couple'
-typedef struct error_couple {
-  err_type type;
-  std::string message;
-
-  // error_couple encapsulates the error information
-  error_couple(err_type t, const char* m) : type(t), message(m) {}
-} error_couple;
-
-class __error {
- private:
-  std::vector<error_couple> m_error_couples;
-
-  // The __append function is quite similar to printf family.
-  // Error couple containing the error message gets pushed
-  // to the end of m_error_couples.
-  void __append(err_type type, std::size_t size, const char* fmt, ...) {
-    va_list args;
-    va_start(args, fmt);
-
-    std::vector<char> buffer(size);
-    vsnprintf(&buffer[0], size, fmt, args);
-    m_error_couples.emplace_back(type, &buffer[0]);
-
-    va_end(args);
-  }
-
- public:
-  // The real constructor function of 'error'
-  // This function is meant to be invoked through
-  // functions make_error, make_serror, make_terror
-  // and make_tserror.
-  template <typename... Args>
-  __error(err_type type, std::size_t size, const char* fmt, Args... args) {
-    __append(type, size, fmt, args...);
-  }
-
-  // The function append can be used to append an ordinary
-  // error couple to the existing couples.
-  template <typename... Args>
-  void append(const char* fmt, Args... args) {
-    __append(err_type::generic_error, default_error_message_size, fmt, args...);
-  }
-
-  // The function sappend can be used to append an error
-  // couple with a specific size limit for its message to
-  // the existing error couples.
-  template <typename... Args>
-  void sappend(std::size_t size, const char* fmt, Args... args) {
-    __append(err_type::generic_error, size, fmt, args...);
-  }
-
-  // The function tappend can used to append an error
-  // couple with a specific error type to the existing
-  // error couples.
-  template <typename... Args>
-  void tappend(err_type type, const char* fmt, Args... args) {
-    __append(type, default_error_message_size, fmt, args...);
-  }
-
-  // The function tsappend can be used to append an error
-  // couple with a specific size and a specific error type
-  // to the existing error couples.
-  template <typename... Args>
-  void tsappend(err_type type, std::size_t size, const char* fmt, Args... args) {
-    __append(type, size, fmt, args...);
-  }
-
-  // The function message can be used to get the message
-  // of the first error couple. It's quite useful for simple
-  // errors that are represented by one couple.
-  const std::string& message() {
-    if (m_error_couples.size() > 0) {
-      return m_error_couples[0].message;
-    }
-
-    fprintf(stderr, "Function message() was called on an empty error\n");
-    return static_default_message;
-  }
-
-  // The function type can be used to get the error type
-  // of the first error couple. It's quite useful for simple
-  // errors that are represented by one couple.
-  err_type type() {
-    if (m_error_couples.size() > 0) {
-      return m_error_couples[0].type;
-    }
-
-    fprintf(stderr, "Function type() was called on an empty error\n");
-    return err_type::generic_error;
-  }
-
-  // The function cmessage can be used to get the c-like message
-  // of the first error couple. It's quite useful for simple
-  // errors that are represented by one couple.
-  const char* cmessage() {
-    if (m_error_couples.size() > 0) {
-      return m_error_couples[0].message.c_str();
-    }
-
-    fprintf(stderr, "Function cmessage() was called on an empty error\n");
-    return static_default_message.c_str();
-  }
-
-  // The function couples can be used to retrieve the vector of
-  // error couples.
-  const std::vector<error_couple>& couples() { return m_error_couples; }
-};
-
-// The function make_error can be used to create a new error.
-// It provides a signature that feels like printf. It creates
-// a generic_error with the default_error_message_size limit.
-template <typename... Args>
-inline error make_error(const char* fmt, Args... args) {
-  return std::make_unique<__error>(err_type::generic_error, default_error_message_size, fmt, args...);
-}
-
-// The function make_serror can be used to create errors of type
-// generic_error with a specific message size limit. Please notice
-// that the limit will not be inherited to the following errors
-// that get appended to the base error object returned by this
-// function.
-template <typename... Args>
-inline error make_serror(std::size_t size, const char* fmt, Args... args) {
-  return std::make_unique<__error>(err_type::generic_error, size, fmt, args...);
-}
-
-// The function make_terror can be used to create errors of a
-// specific type with the default message size limit. The type
-// does not get inherited by the appended messages to the object
-// returned by this function.
-template <typename... Args>
-inline error make_terror(err_type type, const char* fmt, Args... args) {
-  return std::make_unique<__error>(type, default_error_message_size, fmt, args...);
-}
-
-// The function make_tserror can be used to create errors of
-// a specific type with a specific message size limit. These
-// specific values do not get inherited by the appended error
-// couples to the object returned by this function.
-template <typename... Args>
-inline error make_tserror(err_type type, std::size_t size, const char* fmt, Args... args) {
-  return std::make_unique<__error>(type, size, fmt, args...);
-}
-}  // namespace errors
+/*
+MIT License
+
+Copyright (c) 2022 Danis Ozdemir
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include <cpp_errors_fwd.h>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+#include <string>
+#include <string_view>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <time.h>
+
+#ifdef __stringfy_err
+#error __stringfy_err is defined elsewhere
+#endif
+
+// The library can be used with -fno-exceptions. In that mode nothing
+// in it throws: allocation failures are reported through the nothrow
+// forms of new, and the error objects degrade to a preallocated
+// not_enough_memory error instead.
+#if defined(__cpp_exceptions) || defined(__EXCEPTIONS)
+#define __CPP_ERRORS_TRY try
+#define __CPP_ERRORS_CATCH_BAD_ALLOC catch (const std::bad_alloc&)
+#else
+#define __CPP_ERRORS_TRY if (true)
+#define __CPP_ERRORS_CATCH_BAD_ALLOC else
+#define __CPP_ERRORS_NOTHROW_STORAGE
+#endif
+
+// Creating and extending errors is the unusual path, so it's marked
+// cold and kept out of line: the compiler then moves it, together with
+// the branches leading to it, away from the hot code of the callers.
+// __CPP_ERRORS_UNLIKELY marks the checks for an error the same way.
+// Defining CPP_ERRORS_NO_COLD turns both off, which is mostly useful
+// to measure what they are worth, see benchmarks/code_size.
+#ifndef CPP_ERRORS_NO_COLD
+#define __CPP_ERRORS_COLD [[gnu::cold, gnu::noinline]]
+#define __CPP_ERRORS_UNLIKELY(x) __builtin_expect(static_cast<bool>(x), false)
+#else
+#define __CPP_ERRORS_COLD
+#define __CPP_ERRORS_UNLIKELY(x) static_cast<bool>(x)
+#endif
+
+// The library fires USDT probes of the provider cpp_errors when
+// <sys/sdt.h> is available, unless CPP_ERRORS_NO_PROBES is defined:
+//
+// error_create(type, message, file, function, line)   the first couple
+// error_append(type, message, file, function, line)   every other couple
+// error_destroy(type, message, couple_count)          an error is freed
+// out_of_memory()                                     the preallocated error is handed out
+//
+// file and function are NULL and line is 0 for couples without a
+// location. A probe nobody is attached to costs a single nop, and tools
+// like perf and bpftrace can attach to a running process, e.g.
+//
+// bpftrace -e 'usdt:./server:cpp_errors:error_create { @[arg0, str(arg1)] = count(); }'
+#if !defined(CPP_ERRORS_NO_PROBES) && __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define __CPP_ERRORS_PROBES
+#endif
+
+namespace errors {
+// The default max size for error message buffer
+inline constexpr std::size_t default_error_message_size = 1024;
+
+// The message of the preallocated not_enough_memory error
+inline constexpr char __out_of_memory_message[] = "out of memory";
+
+// Function c_str returns a c-string describing
+// the err_type e, when it's given e as input
+// parameter.
+inline const char* c_str(err_type e) {
+  static const char* conversion_array[] = {
+#define __stringfy_err(a) #a
+#define __DEFINE_ERROR_T(e) __stringfy_err(e),
+#include <error_types/predefined_errors.h>
+#include <error_types/user_defined_errors.h>
+#undef __DEFINE_ERROR_T
+#undef __stringfy_err
+  };
+
+  return conversion_array[static_cast<int>(e)];
+}
+
+// error_traits holds the compile-time policies of an error type: the
+// size limit of its messages, whether the messages are stored at all
+// and whether the location of the caller is captured. They are set
+// with __DEFINE_ERROR_TRAITS next to the definition of the type, and
+// used by make_error<type> and append<type>, which need no runtime
+// size. Messages which don't fit in the stack buffer of basic_error are
+// formatted on the heap, so message_size can be large.
+template <err_type E>
+struct error_traits {
+  static constexpr std::size_t message_size = default_error_message_size;
+  static constexpr bool store_message = true;
+  static constexpr bool capture_location = false;
+};
+
+#define __DEFINE_ERROR_T(e)
+#define __DEFINE_ERROR_TRAITS(e, size, store, location)     \
+  template <>                                               \
+  struct error_traits<err_type::e> {                        \
+    static constexpr std::size_t message_size = size;       \
+    static constexpr bool store_message = store;            \
+    static constexpr bool capture_location = location;      \
+  };
+#include <error_types/predefined_errors.h>
+#include <error_types/user_defined_errors.h>
+#undef __DEFINE_ERROR_TRAITS
+#undef __DEFINE_ERROR_T
+
+// The number of error types, predefined and user defined.
+inline constexpr std::size_t err_type_count = 0
+#define __DEFINE_ERROR_T(e) +1
+#include <error_types/predefined_errors.h>
+#include <error_types/user_defined_errors.h>
+#undef __DEFINE_ERROR_T
+    ;
+
+// err_type_set is a set of error types, holding one bit per type, so
+// adding a type and checking for one or for any of another set are a
+// few bitwise operations on a couple of words.
+struct err_type_set {
+  static constexpr std::size_t word_count = (err_type_count + 63) / 64;
+
+  std::uint64_t words[word_count] = {};
+
+  constexpr err_type_set() = default;
+
+  constexpr void insert(err_type type) {
+    std::size_t index = static_cast<std::size_t>(type);
+    words[index / 64] |= std::uint64_t(1) << (index % 64);
+  }
+
+  constexpr bool contains(err_type type) const {
+    std::size_t index = static_cast<std::size_t>(type);
+    return (words[index / 64] >> (index % 64)) & 1;
+  }
+
+  constexpr bool intersects(const err_type_set& other) const {
+    std::uint64_t common = 0;
+    for (std::size_t i = 0; i < word_count; i++) {
+      common |= words[i] & other.words[i];
+    }
+    return common != 0;
+  }
+};
+
+// error_category enum encapsulates the categories of error types,
+// defined in error_types/predefined_categories.h and
+// error_types/user_defined_categories.h.
+enum class error_category {
+#define __DEFINE_ERROR_CATEGORY(c) c,
+#define __DEFINE_ERROR_CATEGORY_MEMBER(c, e)
+#include <error_types/predefined_categories.h>
+#include <error_types/user_defined_categories.h>
+#undef __DEFINE_ERROR_CATEGORY_MEMBER
+#undef __DEFINE_ERROR_CATEGORY
+};
+
+// The function __make_category_set collects the types of the category
+// c into a set. It only runs at compile time.
+constexpr err_type_set __make_category_set(error_category c) {
+  err_type_set types;
+#define __DEFINE_ERROR_CATEGORY(c)
+#define __DEFINE_ERROR_CATEGORY_MEMBER(category, e) \
+  if (c == error_category::category) {              \
+    types.insert(err_type::e);                      \
+  }
+#include <error_types/predefined_categories.h>
+#include <error_types/user_defined_categories.h>
+#undef __DEFINE_ERROR_CATEGORY_MEMBER
+#undef __DEFINE_ERROR_CATEGORY
+  return types;
+}
+
+// category_types holds the set of types of every category, indexed by
+// the category.
+inline constexpr err_type_set category_types[] = {
+#define __DEFINE_ERROR_CATEGORY(c) __make_category_set(error_category::c),
+#define __DEFINE_ERROR_CATEGORY_MEMBER(c, e)
+#include <error_types/predefined_categories.h>
+#include <error_types/user_defined_categories.h>
+#undef __DEFINE_ERROR_CATEGORY_MEMBER
+#undef __DEFINE_ERROR_CATEGORY
+};
+
+// The function types_of returns the set of types of the category c.
+constexpr const err_type_set& types_of(error_category c) { return category_types[static_cast<int>(c)]; }
+
+// The function __make_retryable_set collects the types which are
+// transient but not permanent. It only runs at compile time.
+constexpr err_type_set __make_retryable_set() {
+  err_type_set types;
+  const err_type_set& transient = types_of(error_category::transient);
+  const err_type_set& permanent = types_of(error_category::permanent);
+  for (std::size_t i = 0; i < err_type_set::word_count; i++) {
+    types.words[i] = transient.words[i] & ~permanent.words[i];
+  }
+  return types;
+}
+
+// retryable_types holds the types which are worth retrying: those of
+// the transient category, minus those of the permanent category. Both
+// can be extended in error_types/user_defined_categories.h.
+inline constexpr err_type_set retryable_types = __make_retryable_set();
+
+// The function is_retryable reports whether the type type is worth
+// retrying.
+constexpr bool is_retryable(err_type type) { return retryable_types.contains(type); }
+
+// error_location is the place in the code where a couple was created.
+// It's only captured for the error types whose traits ask for it, and
+// it points at static strings, so capturing it doesn't allocate.
+struct error_location {
+  const char* file = nullptr;
+  const char* function = nullptr;
+  int line = 0;
+
+  explicit operator bool() const { return file != nullptr; }
+
+  bool operator==(const error_location& other) const {
+    return line == other.line && same(file, other.file) && same(function, other.function);
+  }
+  bool operator!=(const error_location& other) const { return !(*this == other); }
+
+ private:
+  static bool same(const char* a, const char* b) {
+    return a == b || (a != nullptr && b != nullptr && __builtin_strcmp(a, b) == 0);
+  }
+};
+
+// __located_format is a printf format string which remembers where it
+// was written. The default arguments are evaluated where the function
+// taking it is called, which gives make_error<type> the location of its
+// caller without a macro.
+struct __located_format {
+  const char* fmt;
+  error_location location;
+
+  __located_format(const char* f, const char* file = __builtin_FILE(), const char* function = __builtin_FUNCTION(),
+                   int line = __builtin_LINE())
+      : fmt(f), location{file, function, line} {}
+};
+
+// Function str returns an std::string describing
+// the err_type e, when it's given e as input
+// parameter.
+inline std::string str(err_type e) {
+  std::string result = c_str(e);
+  return result;
+}
+
+// The function __report_empty_error prints the diagnostic for
+// accessors called on an error without couples. It's kept out of
+// line, as it's never on a path that matters.
+[[gnu::cold, gnu::noinline]] inline void __report_empty_error(const char* function_name) {
+  fprintf(stderr, "Function %s() was called on an empty error\n", function_name);
+}
+
+// The function __format_message formats fmt and args into buffer of
+// buffer_size bytes, and returns the length of the message, limited
+// to size - 1 bytes. Only the beginning of the message is in buffer
+// when the returned length doesn't fit in it. It's shared by every
+// instantiation of basic_error, so the formatting code exists once.
+__CPP_ERRORS_COLD inline std::size_t __format_message(char* buffer, std::size_t buffer_size, std::size_t size,
+                                                      const char* fmt, va_list args) {
+  int needed = vsnprintf(buffer, buffer_size, fmt, args);
+  std::size_t length = needed > 0 ? static_cast<std::size_t>(needed) : 0;
+  if (length >= size) {
+    length = size > 0 ? size - 1 : 0;
+  }
+  return length;
+}
+
+// error_budget limits the size of a single error. When a limit is
+// exceeded, couples are dropped from the middle of the chain: the first
+// max_couples / 2 couples, which tell how things started, and the most
+// recent ones are kept, and at least the first and the last couple
+// always stay. Later drops happen at the same position as the first
+// ones, so the dropped couples are always a single gap. Bytes are
+// counted like in error_memory_stats, fields included, but fields
+// themselves are never dropped. A limit of 0 means no limit.
+struct error_budget {
+  std::size_t max_couples = 0;
+  std::size_t max_bytes = 0;
+};
+
+// error_memory_stats is a snapshot of the memory held by all the errors
+// of the process. Bytes are the sizes of the couples, of their messages
+// and of the fields, which is close to, but not exactly, what the
+// allocator hands out.
+//
+// Live errors and bytes are only counted while the accounting is on,
+// that is while a soft memory limit or a default budget is set, so
+// that errors don't all update the same counters otherwise. Errors
+// created while it's off are never counted, not even once it's on. An
+// error which is counted has to be destroyed for its count to go away:
+// errors living in a std::pmr arena which is released in one shot,
+// without destroying them, stay counted for good and eventually push
+// the live bytes over the soft limit. Keep the accounting off, or
+// destroy such errors, when using arenas like that.
+struct error_memory_stats {
+  std::size_t live_errors;
+  std::size_t live_bytes;
+  std::size_t soft_limit;
+  // Couples stored without a message, because live_bytes was over
+  // soft_limit when they were appended.
+  std::size_t degraded_couples;
+  // Couples dropped to keep errors within their budgets.
+  std::size_t dropped_couples;
+};
+
+// __error_memory_accounting holds the process-wide accounting of the
+// errors. Every counter is updated with relaxed atomics, the numbers
+// are meant for health checks, not for synchronization. The counters
+// are plain integers used through the GCC atomic builtins below, which
+// keeps <atomic> out of this header.
+struct __error_memory_accounting {
+  bool enabled;
+  std::size_t live_errors;
+  std::size_t live_bytes;
+  std::size_t soft_limit;
+  std::size_t degraded_couples;
+  std::size_t dropped_couples;
+  std::size_t default_max_couples;
+  std::size_t default_max_bytes;
+};
+
+inline __error_memory_accounting __error_memory;
+
+inline std::size_t __load(const std::size_t& counter) { return __atomic_load_n(&counter, __ATOMIC_RELAXED); }
+
+inline void __store(std::size_t& counter, std::size_t value) { __atomic_store_n(&counter, value, __ATOMIC_RELAXED); }
+
+inline void __add(std::size_t& counter, std::size_t n) { __atomic_fetch_add(&counter, n, __ATOMIC_RELAXED); }
+
+inline void __sub(std::size_t& counter, std::size_t n) { __atomic_fetch_sub(&counter, n, __ATOMIC_RELAXED); }
+
+inline bool __accounting_enabled() { return __atomic_load_n(&__error_memory.enabled, __ATOMIC_RELAXED); }
+
+inline void __update_accounting() {
+  bool enabled = __load(__error_memory.soft_limit) != 0 || __load(__error_memory.default_max_couples) != 0 ||
+                 __load(__error_memory.default_max_bytes) != 0;
+  __atomic_store_n(&__error_memory.enabled, enabled, __ATOMIC_RELAXED);
+}
+
+// The function memory_stats returns the current totals of all errors.
+inline error_memory_stats memory_stats() {
+  return error_memory_stats{__load(__error_memory.live_errors), __load(__error_memory.live_bytes),
+                            __load(__error_memory.soft_limit), __load(__error_memory.degraded_couples),
+                            __load(__error_memory.dropped_couples)};
+}
+
+// The function set_soft_memory_limit sets a limit on the live bytes of
+// all errors. Beyond it, errors keep working but new couples are stored
+// with their type only, without even formatting their message. 0, the
+// default, means no limit. A limit turns the accounting on, see
+// error_memory_stats; SIZE_MAX turns it on without limiting anything.
+inline void set_soft_memory_limit(std::size_t bytes) {
+  __store(__error_memory.soft_limit, bytes);
+  __update_accounting();
+}
+
+// The function set_default_budget sets the budget every new error
+// starts with. It can still be changed per error with set_budget. A
+// default budget turns the accounting on too.
+inline void set_default_budget(const error_budget& budget) {
+  __store(__error_memory.default_max_couples, budget.max_couples);
+  __store(__error_memory.default_max_bytes, budget.max_bytes);
+  __update_accounting();
+}
+
+inline bool __over_soft_memory_limit() {
+  std::size_t limit = __load(__error_memory.soft_limit);
+  return limit != 0 && __load(__error_memory.live_bytes) > limit;
+}
+
+// The function __now returns the wall clock time in nanoseconds since
+// the epoch. It uses the C header, which <memory> already pulls in
+// through the threads support, rather than the declarations <ctime>
+// adds on top of it.
+inline std::int64_t __now() {
+  timespec now;
+  timespec_get(&now, TIME_UTC);
+  return static_cast<std::int64_t>(now.tv_sec) * 1000000000 + now.tv_nsec;
+}
+
+// Without exceptions, std::allocator can't report a failure, it ends
+// the process, and std::string and std::vector can't be given memory
+// taken some other way. Before a container of an error using the
+// default allocator allocates, the error therefore tries an allocation
+// of the same size with nothrow new and frees it, see
+// basic_error::__make_room. If there is no memory, the operation isn't
+// attempted and the error reports it. The freed block is what the
+// container normally gets right after, so only memory taken by another
+// thread in between still ends the process.
+//
+// Other allocators report failures in their own way.
+#ifdef __CPP_ERRORS_NOTHROW_STORAGE
+inline bool __can_allocate(std::size_t bytes) {
+  void* memory = ::operator new(bytes, std::nothrow);
+  ::operator delete(memory);
+  return memory != nullptr;
+}
+#endif
+
+// basic_error_couple encapsulates the error information. The
+// message is allocated through Alloc.
+template <typename Alloc>
+struct basic_error_couple {
+  typedef std::basic_string<char, std::char_traits<char>,
+                            typename std::allocator_traits<Alloc>::template rebind_alloc<char>>
+      string_type;
+
+  err_type type;
+  string_type message;
+  error_location location;
+  // How many times the couple was appended in a row, and when it was
+  // appended last, in nanoseconds since the epoch. Only errors which
+  // coalesce duplicates count repeats and record the time, see
+  // basic_error::coalesce_duplicates.
+  std::size_t repeats = 1;
+  std::int64_t last_seen = 0;
+
+  basic_error_couple(err_type t, const char* m, const Alloc& a = Alloc()) : type(t), message(m, a) {}
+  basic_error_couple(err_type t, const char* m, std::size_t length, const Alloc& a = Alloc())
+      : type(t), message(m, length, a) {}
+  basic_error_couple(err_type t, string_type&& m) : type(t), message(std::move(m)) {}
+};
+
+// Definition of 'error_couple'
+typedef basic_error_couple<std::allocator<char>> error_couple;
+
+// field_kind tells which member of an error_field holds its value.
+enum class field_kind : std::uint8_t { int64, uint64, float64, boolean, string };
+
+// error_field is a typed key/value attribute of an error, e.g. an id,
+// a size or a path. Fields are kept apart from the messages, so that
+// they can be indexed by log pipelines and are only formatted when
+// somebody asks for them. Keys are not copied, they should be string
+// literals or otherwise outlive the error. Strings are stored inline
+// and get truncated to short_string_size - 1 bytes at most, without
+// splitting a UTF-8 sequence.
+struct error_field {
+  static const std::size_t short_string_size = 24;
+
+  const char* key;
+  union {
+    std::int64_t i;
+    std::uint64_t u;
+    double d;
+    bool b;
+    char s[short_string_size];
+  } value;
+  field_kind kind;
+  std::uint8_t length;
+
+  // The function make creates a field for any integer, floating point,
+  // bool or string-like value.
+  template <typename T>
+  static error_field make(const char* key, const T& v) {
+    error_field f;
+    f.key = key;
+    f.length = 0;
+    if constexpr (std::is_same<T, bool>::value) {
+      f.kind = field_kind::boolean;
+      f.value.b = v;
+    } else if constexpr (std::is_integral<T>::value && std::is_signed<T>::value) {
+      f.kind = field_kind::int64;
+      f.value.i = v;
+    } else if constexpr (std::is_integral<T>::value || std::is_enum<T>::value) {
+      f.kind = field_kind::uint64;
+      f.value.u = static_cast<std::uint64_t>(v);
+    } else if constexpr (std::is_floating_point<T>::value) {
+      f.kind = field_kind::float64;
+      f.value.d = v;
+    } else {
+      static_assert(std::is_convertible<const T&, std::string_view>::value,
+                    "Fields can be integers, floating point numbers, bools or strings");
+      std::string_view str(v);
+      f.kind = field_kind::string;
+      std::size_t length = str.size();
+      if (length >= short_string_size) {
+        // Back off while the cut would fall on a continuation byte.
+        length = short_string_size - 1;
+        while (length > 0 && (static_cast<unsigned char>(str[length]) & 0xc0) == 0x80) {
+          length--;
+        }
+      }
+      f.length = static_cast<std::uint8_t>(length);
+      str.copy(f.value.s, f.length);
+      f.value.s[f.length] = '\0';
+    }
+    return f;
+  }
+
+  // The function str returns the value of a string field, without
+  // copying it.
+  std::string_view str() const { return std::string_view(value.s, length); }
+
+  // The function visit calls f with the key and the value of the field
+  // in its own type: std::int64_t, std::uint64_t, double, bool or
+  // std::string_view.
+  template <typename F>
+  void visit(F&& f) const {
+    switch (kind) {
+      case field_kind::int64:
+        f(key, value.i);
+        break;
+      case field_kind::uint64:
+        f(key, value.u);
+        break;
+      case field_kind::float64:
+        f(key, value.d);
+        break;
+      case field_kind::boolean:
+        f(key, value.b);
+        break;
+      case field_kind::string:
+        f(key, str());
+        break;
+    }
+  }
+};
+
+// The function __append_json_string appends str to out, quoted and
+// escaped in JSON style.
+template <typename String>
+inline void __append_json_string(String& out, std::string_view str) {
+  out += '"';
+  for (char c : str) {
+    if (c == '"' || c == '\\') {
+      out += '\\';
+      out += c;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      char buffer[8];
+      int length = snprintf(buffer, sizeof(buffer), "\\u%04x", static_cast<unsigned>(c));
+      out.append(buffer, length);
+    } else {
+      out += c;
+    }
+  }
+  out += '"';
+}
+
+// The function __append_field_value appends the textual form of the
+// value of f to out. Strings get quoted and escaped in JSON style.
+template <typename String>
+inline void __append_field_value(String& out, const error_field& f) {
+  char buffer[32];
+  int length = 0;
+  switch (f.kind) {
+    case field_kind::int64:
+      length = snprintf(buffer, sizeof(buffer), "%lld", static_cast<long long>(f.value.i));
+      break;
+    case field_kind::uint64:
+      length = snprintf(buffer, sizeof(buffer), "%llu", static_cast<unsigned long long>(f.value.u));
+      break;
+    case field_kind::float64:
+      if (f.value.d != f.value.d || f.value.d - f.value.d != 0) {
+        // JSON has no NaN or infinity.
+        out += "null";
+        return;
+      }
+      length = snprintf(buffer, sizeof(buffer), "%.17g", f.value.d);
+      break;
+    case field_kind::boolean:
+      out += f.value.b ? "true" : "false";
+      return;
+    case field_kind::string:
+      __append_json_string(out, f.str());
+      return;
+  }
+  out.append(buffer, length);
+}
+
+template <typename Alloc>
+class basic_error {
+ public:
+  typedef Alloc allocator_type;
+  typedef basic_error_couple<Alloc> couple_type;
+  typedef typename couple_type::string_type string_type;
+  typedef std::vector<couple_type, typename std::allocator_traits<Alloc>::template rebind_alloc<couple_type>>
+      couple_vector;
+  typedef std::vector<error_field, typename std::allocator_traits<Alloc>::template rebind_alloc<error_field>>
+      field_vector;
+
+ private:
+  // Messages shorter than this are formatted on the stack before
+  // they get copied into their couple.
+  static const std::size_t stack_buffer_size = 256;
+
+  couple_vector m_error_couples;
+  field_vector m_fields;
+  err_type_set m_types;
+  bool m_preallocated = false;
+  bool m_coalesce = false;
+  // The number of shared_errors sharing this error, 0 when it isn't
+  // shared. It fits in the padding before m_budget.
+  std::uint32_t m_shared_refs = 0;
+  error_budget m_budget;
+  std::size_t m_bytes = 0;
+  std::size_t m_dropped = 0;
+  // Where the dropped couples used to be, set by the first drop.
+  std::size_t m_dropped_at = 0;
+  // Whether the error takes part in the process-wide accounting, which
+  // is decided when it's created.
+  bool m_accounted = false;
+
+  explicit basic_error(const Alloc& alloc) : m_error_couples(alloc), m_fields(alloc) { __created(); }
+
+  // The functions below keep the process-wide accounting up to date.
+  // The bytes of the error itself are always kept, for its budget. The
+  // preallocated error isn't accounted for, it exists anyway.
+  void __created() {
+    m_budget.max_couples = __load(__error_memory.default_max_couples);
+    m_budget.max_bytes = __load(__error_memory.default_max_bytes);
+    m_accounted = __accounting_enabled();
+    if (m_accounted) {
+      __add(__error_memory.live_errors, 1);
+    }
+  }
+
+  void __account(std::size_t bytes) {
+    m_bytes += bytes;
+    if (m_accounted) {
+      __add(__error_memory.live_bytes, bytes);
+    }
+  }
+
+  void __unaccount(std::size_t bytes) {
+    m_bytes -= bytes;
+    if (m_accounted) {
+      __sub(__error_memory.live_bytes, bytes);
+    }
+  }
+
+  // The function __forget takes this error out of the accounting, when
+  // it's destroyed or assigned to.
+  void __forget() {
+    if (m_accounted) {
+      __sub(__error_memory.live_errors, 1);
+      __sub(__error_memory.live_bytes, m_bytes);
+    }
+  }
+
+  // The function __moved_from leaves an error whose couples and fields
+  // were moved out without any, as if they had never been appended.
+  void __moved_from() {
+    m_error_couples.clear();
+    m_fields.clear();
+    m_types = err_type_set();
+    m_bytes = 0;
+    m_dropped = 0;
+    m_dropped_at = 0;
+  }
+
+  static std::size_t __couple_bytes(const couple_type& couple) { return sizeof(couple_type) + couple.message.size(); }
+
+  bool __over_budget() const {
+    return (m_budget.max_couples != 0 && m_error_couples.size() > m_budget.max_couples) ||
+           (m_budget.max_bytes != 0 && m_bytes > m_budget.max_bytes);
+  }
+
+  // The function __enforce_budget drops couples from the middle of the
+  // chain until the error fits its budget, see error_budget. Once
+  // couples are dropped, later drops happen at the same position, even
+  // if the budget changes, so that they stay a single gap. The couples
+  // are shifted by hand: vector::erase pulls the whole algorithm
+  // machinery into every translation unit which creates an error.
+  void __enforce_budget() {
+    if (m_dropped == 0) {
+      m_dropped_at = m_budget.max_couples / 2 > 0 ? m_budget.max_couples / 2 : 1;
+    }
+    const std::size_t keep = m_dropped_at;
+    while (m_error_couples.size() > keep + 1 && __over_budget()) {
+      __unaccount(__couple_bytes(m_error_couples[keep]));
+      for (std::size_t i = keep; i + 1 < m_error_couples.size(); i++) {
+        m_error_couples[i] = std::move(m_error_couples[i + 1]);
+      }
+      m_error_couples.pop_back();
+      m_dropped++;
+      __add(__error_memory.dropped_couples, 1);
+    }
+  }
+
+  // The function __checks_allocations tells whether the containers of
+  // the error have to check that memory is available before allocating.
+  static constexpr bool __checks_allocations() {
+#ifdef __CPP_ERRORS_NOTHROW_STORAGE
+    return std::is_same<Alloc, std::allocator<char>>::value;
+#else
+    return false;
+#endif
+  }
+
+  // The function __grow makes room for one more element in v. Without
+  // exceptions, it first checks that the new storage of v can be had
+  // and returns false if it can't. Otherwise v grows by itself.
+  template <typename Vector>
+  static bool __grow(Vector& v) {
+#ifdef __CPP_ERRORS_NOTHROW_STORAGE
+    if constexpr (__checks_allocations()) {
+      if (v.size() == v.capacity()) {
+        std::size_t capacity = v.empty() ? 1 : 2 * v.size();
+        if (!__can_allocate(capacity * sizeof(typename Vector::value_type))) {
+          return false;
+        }
+        v.reserve(capacity);
+      }
+    }
+#else
+    (void)v;
+#endif
+    return true;
+  }
+
+  // The function __make_room makes sure that a couple with a message of
+  // length bytes can be appended.
+  bool __make_room(std::size_t length) {
+    if (!__grow(m_error_couples)) {
+      return false;
+    }
+#ifdef __CPP_ERRORS_NOTHROW_STORAGE
+    if constexpr (__checks_allocations()) {
+      if (length > string_type().capacity()) {
+        return __can_allocate(length + 1);
+      }
+    }
+#else
+    (void)length;
+#endif
+    return true;
+  }
+
+  // The __append function is quite similar to printf family.
+  // Error couple containing the error message gets pushed
+  // to the end of m_error_couples. It returns false if the
+  // couple could not be stored due to lack of memory.
+  bool __append(err_type type, std::size_t size, const char* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    bool stored = __vappend(type, size, fmt, args);
+    va_end(args);
+    return stored;
+  }
+
+  bool __vappend(err_type type, std::size_t size, const char* fmt, va_list args) {
+    if (m_preallocated) {
+      return false;
+    }
+
+    va_list args_copy;
+    va_copy(args_copy, args);
+
+    const bool degraded = __over_soft_memory_limit();
+    char buffer[stack_buffer_size];
+    std::size_t length = 0;
+    if (!degraded) {
+      length = __format_message(buffer, sizeof(buffer), size, fmt, args);
+    }
+
+    bool stored = false;
+    __CPP_ERRORS_TRY {
+      bool coalesced = false;
+      if (length < sizeof(buffer)) {
+        coalesced = __coalesce(type, error_location(), std::string_view(buffer, length));
+        if (!coalesced && __make_room(length)) {
+          m_error_couples.emplace_back(type, buffer, length, get_allocator());
+          stored = true;
+        }
+      } else if (__make_room(length)) {
+        string_type message(length, '\0', get_allocator());
+        vsnprintf(&message[0], length + 1, fmt, args_copy);
+        coalesced = __coalesce(type, error_location(), message);
+        if (!coalesced) {
+          m_error_couples.emplace_back(type, std::move(message));
+        }
+        stored = true;
+      }
+      if (stored || coalesced) {
+        __appended(type, coalesced, degraded);
+        stored = true;
+      }
+    }
+    __CPP_ERRORS_CATCH_BAD_ALLOC {}
+
+    va_end(args_copy);
+    return stored;
+  }
+
+  // The function __coalesce counts one more repeat of the last couple
+  // instead of appending a new one, if coalescing is enabled and the
+  // last couple has the same type, message and location.
+  bool __coalesce(err_type type, const error_location& location, std::string_view message) {
+    if (!m_coalesce || m_error_couples.empty()) {
+      return false;
+    }
+
+    couple_type& last = m_error_couples.back();
+    if (last.type != type || last.location != location || std::string_view(last.message) != message) {
+      return false;
+    }
+    last.repeats++;
+    return true;
+  }
+
+  // The function __appended updates the bookkeeping of the error after
+  // a couple of type type has been appended or coalesced.
+  void __appended(err_type type, bool coalesced, bool degraded) {
+    if (m_coalesce) {
+      m_error_couples.back().last_seen = __now();
+    }
+    m_types.insert(type);
+    __probe_appended();
+
+    if (degraded) {
+      __add(__error_memory.degraded_couples, 1);
+    }
+    if (!coalesced) {
+      __account(__couple_bytes(m_error_couples.back()));
+      __enforce_budget();
+    }
+  }
+
+  // The function __probe_appended fires the probe of the couple which
+  // has just been appended.
+  void __probe_appended() const {
+#ifdef __CPP_ERRORS_PROBES
+    const couple_type& couple = m_error_couples.back();
+    if (m_error_couples.size() == 1 && couple.repeats == 1) {
+      DTRACE_PROBE5(cpp_errors, error_create, static_cast<int>(couple.type), couple.message.c_str(),
+                    couple.location.file, couple.location.function, couple.location.line);
+    } else {
+      DTRACE_PROBE5(cpp_errors, error_append, static_cast<int>(couple.type), couple.message.c_str(),
+                    couple.location.file, couple.location.function, couple.location.line);
+    }
+#endif
+  }
+
+  // The function __append_static is the compile-time counterpart of
+  // __append, driven by the traits of the type E. Messages are formatted
+  // on the stack up to stack_buffer_size bytes, whatever the message size
+  // of E is, and longer ones are formatted again into their own string.
+  template <err_type E>
+  bool __append_static(const error_location& location, const char* fmt, ...) {
+    typedef error_traits<E> traits;
+    if (m_preallocated) {
+      return false;
+    }
+
+    constexpr std::size_t size = traits::store_message ? traits::message_size : 0;
+    // Only the first byte is set, the rest is written when formatting.
+    char buffer[size == 0 ? 1 : (size < stack_buffer_size ? size : stack_buffer_size)];
+    buffer[0] = '\0';
+    std::size_t length = 0;
+    bool degraded = false;
+    va_list args;
+    va_start(args, fmt);
+    if constexpr (size > 1) {
+      degraded = __over_soft_memory_limit();
+      if (!degraded) {
+        va_list args_copy;
+        va_copy(args_copy, args);
+        length = __format_message(buffer, sizeof(buffer), size, fmt, args_copy);
+        va_end(args_copy);
+      }
+    }
+
+    bool stored = false;
+    __CPP_ERRORS_TRY {
+      const error_location stored_location = traits::capture_location ? location : error_location();
+      bool coalesced = false;
+      if (length < sizeof(buffer)) {
+        coalesced = __coalesce(E, stored_location, std::string_view(buffer, length));
+        if (!coalesced && __make_room(length)) {
+          m_error_couples.emplace_back(E, buffer, length, get_allocator());
+          m_error_couples.back().location = stored_location;
+          stored = true;
+        }
+      } else if (__make_room(length)) {
+        string_type message(length, '\0', get_allocator());
+        vsnprintf(&message[0], length + 1, fmt, args);
+        coalesced = __coalesce(E, stored_location, message);
+        if (!coalesced) {
+          m_error_couples.emplace_back(E, std::move(message));
+          m_error_couples.back().location = stored_location;
+        }
+        stored = true;
+      }
+      if (stored || coalesced) {
+        __appended(E, coalesced, degraded);
+        stored = true;
+      }
+    }
+    __CPP_ERRORS_CATCH_BAD_ALLOC {}
+
+    va_end(args);
+    return stored;
+  }
+
+  template <typename A>
+  friend basic_error<A>* __new_error(const A& alloc);
+
+  template <err_type E, typename... Args>
+  friend error make_error(__located_format fmt, Args... args);
+
+  template <typename A, typename... Args>
+  friend basic_error_ptr<A> allocate_error(const A& alloc, err_type type, std::size_t size, const char* fmt,
+                                           Args... args);
+
+ public:
+  // Tag type of the constructor of the preallocated
+  // not_enough_memory error.
+  struct __preallocated_tag {};
+
+  // It's created when memory may already be short, so it doesn't
+  // allocate: it stores no couple, and message, type and cmessage report
+  // not_enough_memory and __out_of_memory_message instead.
+  explicit basic_error(__preallocated_tag) : m_preallocated(true) { m_types.insert(err_type::not_enough_memory); }
+
+  // The function __can_copy tells whether the memory a copy of this
+  // error allocates can be had. Without exceptions, the library checks
+  // it before copying an error itself, like __make_room does before an
+  // append.
+  bool __can_copy() const {
+#ifdef __CPP_ERRORS_NOTHROW_STORAGE
+    if constexpr (__checks_allocations()) {
+      if (!m_error_couples.empty() && !__can_allocate(m_error_couples.size() * sizeof(couple_type))) {
+        return false;
+      }
+      for (const couple_type& couple : m_error_couples) {
+        if (couple.message.size() > string_type().capacity() && !__can_allocate(couple.message.size() + 1)) {
+          return false;
+        }
+      }
+      return m_fields.empty() || __can_allocate(m_fields.size() * sizeof(error_field));
+    }
+#endif
+    return true;
+  }
+
+  // The functions __share, __unshare and __shared_count keep the count
+  // of the shared_errors sharing this error. __unshare returns true when
+  // the last one lets it go. The count isn't copied or moved along with
+  // the error.
+  void __share() { __atomic_fetch_add(&m_shared_refs, 1, __ATOMIC_RELAXED); }
+  bool __unshare() { return __atomic_fetch_sub(&m_shared_refs, 1, __ATOMIC_ACQ_REL) == 1; }
+  std::size_t __shared_count() const { return __atomic_load_n(&m_shared_refs, __ATOMIC_ACQUIRE); }
+
+  // The real constructor function of 'error'
+  // This function is meant to be invoked through
+  // functions make_error, make_serror, make_terror
+  // and make_tserror.
+  template <typename... Args>
+  basic_error(err_type type, std::size_t size, const char* fmt, Args... args) {
+    __created();
+    __append(type, size, fmt, args...);
+  }
+
+  // Copies and moves keep the process-wide accounting right. A moved
+  // from error is left without couples, fields, types and drops.
+  basic_error(const basic_error& other)
+      : m_error_couples(other.m_error_couples),
+        m_fields(other.m_fields),
+        m_types(other.m_types),
+        m_preallocated(other.m_preallocated),
+        m_coalesce(other.m_coalesce),
+        m_budget(other.m_budget),
+        m_dropped(other.m_dropped),
+        m_dropped_at(other.m_dropped_at),
+        m_accounted(!other.m_preallocated && __accounting_enabled()) {
+    if (m_accounted) {
+      __add(__error_memory.live_errors, 1);
+    }
+    __account(other.m_bytes);
+  }
+
+  basic_error(basic_error&& other) noexcept
+      : m_error_couples(std::move(other.m_error_couples)),
+        m_fields(std::move(other.m_fields)),
+        m_types(other.m_types),
+        m_preallocated(other.m_preallocated),
+        m_coalesce(other.m_coalesce),
+        m_budget(other.m_budget),
+        m_bytes(other.m_bytes),
+        m_dropped(other.m_dropped),
+        m_dropped_at(other.m_dropped_at),
+        m_accounted(other.m_accounted) {
+    other.__moved_from();
+    if (m_accounted) {
+      __add(__error_memory.live_errors, 1);
+    }
+  }
+
+  basic_error& operator=(const basic_error& other) {
+    if (this != &other) {
+      basic_error copy(other);
+      *this = std::move(copy);
+    }
+    return *this;
+  }
+
+  basic_error& operator=(basic_error&& other) noexcept(std::is_nothrow_move_assignable<couple_vector>::value &&
+                                                       std::is_nothrow_move_assignable<field_vector>::value) {
+    if (this != &other) {
+      __forget();
+      m_error_couples = std::move(other.m_error_couples);
+      m_fields = std::move(other.m_fields);
+      m_types = other.m_types;
+      m_preallocated = other.m_preallocated;
+      m_coalesce = other.m_coalesce;
+      m_budget = other.m_budget;
+      m_bytes = other.m_bytes;
+      m_dropped = other.m_dropped;
+      m_dropped_at = other.m_dropped_at;
+      m_accounted = other.m_accounted;
+      other.__moved_from();
+      if (m_accounted) {
+        __add(__error_memory.live_errors, 1);
+      }
+    }
+    return *this;
+  }
+
+  ~basic_error() { __forget(); }
+
+  // The function append can be used to append an ordinary
+  // error couple to the existing couples.
+  template <typename... Args>
+  __CPP_ERRORS_COLD void append(const char* fmt, Args... args) {
+    __append(err_type::generic_error, default_error_message_size, fmt, args...);
+  }
+
+  // The function sappend can be used to append an error
+  // couple with a specific size limit for its message to
+  // the existing error couples.
+  template <typename... Args>
+  __CPP_ERRORS_COLD void sappend(std::size_t size, const char* fmt, Args... args) {
+    __append(err_type::generic_error, size, fmt, args...);
+  }
+
+  // The function tappend can used to append an error
+  // couple with a specific error type to the existing
+  // error couples.
+  template <typename... Args>
+  __CPP_ERRORS_COLD void tappend(err_type type, const char* fmt, Args... args) {
+    __append(type, default_error_message_size, fmt, args...);
+  }
+
+  // The function tsappend can be used to append an error
+  // couple with a specific size and a specific error type
+  // to the existing error couples.
+  template <typename... Args>
+  __CPP_ERRORS_COLD void tsappend(err_type type, std::size_t size, const char* fmt, Args... args) {
+    __append(type, size, fmt, args...);
+  }
+
+  // The function append<E> appends a couple of type E, with the size
+  // limit, message and location policies of error_traits<E>.
+  template <err_type E, typename... Args>
+  __CPP_ERRORS_COLD void append(__located_format fmt, Args... args) {
+    __append_static<E>(fmt.location, fmt.fmt, args...);
+  }
+
+  // The function message can be used to get the message
+  // of the first error couple. It's quite useful for simple
+  // errors that are represented by one couple.
+  const string_type& message() const {
+    if (__CPP_ERRORS_UNLIKELY(m_error_couples.empty())) {
+      if (m_preallocated) {
+        static const string_type out_of_memory_message(__out_of_memory_message);
+        return out_of_memory_message;
+      }
+      __report_empty_error("message");
+      static const string_type empty_message;
+      return empty_message;
+    }
+    return m_error_couples[0].message;
+  }
+
+  // The function type can be used to get the error type
+  // of the first error couple. It's quite useful for simple
+  // errors that are represented by one couple.
+  err_type type() const {
+    if (__CPP_ERRORS_UNLIKELY(m_error_couples.empty())) {
+      if (m_preallocated) {
+        return err_type::not_enough_memory;
+      }
+      __report_empty_error("type");
+      return err_type::generic_error;
+    }
+    return m_error_couples[0].type;
+  }
+
+  // The function cmessage can be used to get the c-like message
+  // of the first error couple. It's quite useful for simple
+  // errors that are represented by one couple.
+  const char* cmessage() const {
+    if (__CPP_ERRORS_UNLIKELY(m_error_couples.empty())) {
+      if (m_preallocated) {
+        return __out_of_memory_message;
+      }
+      __report_empty_error("cmessage");
+      return "";
+    }
+    return m_error_couples[0].message.c_str();
+  }
+
+  // The function couples can be used to retrieve the vector of
+  // error couples. The preallocated error has none.
+  const couple_vector& couples() const { return m_error_couples; }
+
+  // The function coalesce_duplicates turns coalescing on or off. While
+  // it's on, appending a couple with the same type, message and location
+  // as the last couple only bumps the repeats and the last_seen of the
+  // last couple, so an error reused across the attempts of a retry loop
+  // doesn't grow with every attempt:
+  //
+  // err->coalesce_duplicates();
+  // while (!connect(host)) {
+  //   err->tappend(errors::err_type::connection_refused, "connecting to %s", host);
+  // }
+  basic_error& coalesce_duplicates(bool enabled = true) {
+    m_coalesce = enabled;
+    return *this;
+  }
+
+  // The function coalescing reports whether duplicates are coalesced.
+  bool coalescing() const { return m_coalesce; }
+
+  // The function set_budget limits the size of this error, dropping
+  // couples right away if it's already too large. See error_budget.
+  basic_error& set_budget(const error_budget& budget) {
+    m_budget = budget;
+    __enforce_budget();
+    return *this;
+  }
+
+  const error_budget& budget() const { return m_budget; }
+
+  // The function dropped returns how many couples were dropped to keep
+  // this error within its budget, and dropped_at the position in the
+  // chain where they used to be. It's recorded when they are dropped,
+  // and is 0 while nothing has been.
+  std::size_t dropped() const { return m_dropped; }
+  std::size_t dropped_at() const { return m_dropped_at; }
+
+  // The function bytes returns the size of the couples, messages and
+  // fields of this error, as counted by the budgets and memory_stats.
+  std::size_t bytes() const { return m_bytes; }
+
+  // The function types returns the set of the types of all the
+  // couples, kept up to date by every append. The types of dropped
+  // couples stay in it.
+  const err_type_set& types() const { return m_types; }
+
+  // The function preallocated tells whether this is the shared
+  // error returned when memory ran out. Appending to it has no
+  // effect.
+  bool preallocated() const { return m_preallocated; }
+
+  // The function add_field attaches a typed key/value attribute to the
+  // error. It's much cheaper than formatting the value into a message,
+  // as nothing gets formatted until the fields are rendered. It returns
+  // the error itself, so that calls can be chained:
+  //
+  // err->add_field("request_id", id).add_field("path", path);
+  template <typename T>
+  __CPP_ERRORS_COLD basic_error& add_field(const char* key, const T& value) {
+    if (!m_preallocated) {
+      __CPP_ERRORS_TRY {
+        if (__grow(m_fields)) {
+          m_fields.push_back(error_field::make(key, value));
+          __account(sizeof(error_field));
+          __enforce_budget();
+        }
+      }
+      __CPP_ERRORS_CATCH_BAD_ALLOC {}
+    }
+    return *this;
+  }
+
+  // The function fields can be used to retrieve the fields in the order
+  // they were added.
+  const field_vector& fields() const { return m_fields; }
+
+  // The function visit_fields calls f(key, value) for each field, where
+  // value is a std::int64_t, std::uint64_t, double, bool or a
+  // std::string_view pointing into the field.
+  template <typename F>
+  void visit_fields(F&& f) const {
+    for (const error_field& field : m_fields) {
+      field.visit(f);
+    }
+  }
+
+  // The function fields_text renders the fields as space separated
+  // key=value pairs, with the strings quoted.
+  std::string fields_text() const {
+    std::string out;
+    for (const error_field& field : m_fields) {
+      if (!out.empty()) {
+        out += ' ';
+      }
+      out += field.key;
+      out += '=';
+      __append_field_value(out, field);
+    }
+    return out;
+  }
+
+  // The function fields_json renders the fields as a JSON object. Keys
+  // are escaped like string values.
+  std::string fields_json() const {
+    std::string out = "{";
+    for (const error_field& field : m_fields) {
+      if (out.size() > 1) {
+        out += ',';
+      }
+      __append_json_string(out, field.key);
+      out += ':';
+      __append_field_value(out, field);
+    }
+    out += '}';
+    return out;
+  }
+
+  // The function get_allocator returns the allocator the couples
+  // and their messages are allocated with.
+  allocator_type get_allocator() const { return allocator_type(m_error_couples.get_allocator()); }
+};
+
+// The function __out_of_memory_error returns the error handed out
+// by the make_* functions when they can't allocate. It's created by
+// the first make_* call rather than by a static initializer in every
+// translation unit, and creating it never allocates, see its
+// constructor.
+template <typename Alloc>
+inline basic_error<Alloc>& __out_of_memory_error() {
+  static basic_error<Alloc> preallocated{typename basic_error<Alloc>::__preallocated_tag{}};
+  return preallocated;
+}
+
+// The function __hand_out_of_memory_error returns the preallocated
+// error to a make_* call which couldn't allocate.
+template <typename Alloc>
+inline basic_error_ptr<Alloc> __hand_out_of_memory_error(basic_error<Alloc>& preallocated) {
+#ifdef __CPP_ERRORS_PROBES
+  DTRACE_PROBE(cpp_errors, out_of_memory);
+#endif
+  return basic_error_ptr<Alloc>(&preallocated);
+}
+
+// The function __new_error creates an empty basic_error with its
+// own storage taken from alloc. It returns nullptr if there is not
+// enough memory.
+template <typename Alloc>
+inline basic_error<Alloc>* __new_error(const Alloc& alloc) {
+  if constexpr (std::is_same<Alloc, std::allocator<char>>::value) {
+    return new (std::nothrow) basic_error<Alloc>(alloc);
+  } else {
+    typedef typename std::allocator_traits<Alloc>::template rebind_alloc<basic_error<Alloc>> node_allocator;
+    node_allocator node_alloc(alloc);
+    basic_error<Alloc>* e = nullptr;
+    __CPP_ERRORS_TRY {
+      e = std::allocator_traits<node_allocator>::allocate(node_alloc, 1);
+      new (e) basic_error<Alloc>(alloc);
+    }
+    __CPP_ERRORS_CATCH_BAD_ALLOC {}
+    return e;
+  }
+}
+
+template <typename Alloc>
+__CPP_ERRORS_COLD inline void basic_error_deleter<Alloc>::operator()(basic_error<Alloc>* e) const noexcept {
+  if (e->preallocated()) {
+    return;
+  }
+
+#ifdef __CPP_ERRORS_PROBES
+  // Errors whose couples were moved away report type -1 and no message.
+  const auto& couples = e->couples();
+  int type = couples.empty() ? -1 : static_cast<int>(couples[0].type);
+  const char* message = couples.empty() ? nullptr : couples[0].message.c_str();
+  DTRACE_PROBE3(cpp_errors, error_destroy, type, message, couples.size());
+#endif
+
+  if constexpr (std::is_same<Alloc, std::allocator<char>>::value) {
+    delete e;
+  } else {
+    typedef typename std::allocator_traits<Alloc>::template rebind_alloc<basic_error<Alloc>> node_allocator;
+    node_allocator node_alloc(e->get_allocator());
+    e->~basic_error<Alloc>();
+    std::allocator_traits<node_allocator>::deallocate(node_alloc, e, 1);
+  }
+}
+
+// The function allocate_error creates an error whose object, couples
+// and messages are all allocated with alloc, and which gives its
+// memory back to alloc when it's destroyed. It never throws,
+// allocation failures yield the preallocated not_enough_memory error.
+// The make_* functions are shorthands of it for the default allocator.
+template <typename Alloc, typename... Args>
+__CPP_ERRORS_COLD inline basic_error_ptr<Alloc> allocate_error(const Alloc& alloc, err_type type, std::size_t size,
+                                                               const char* fmt, Args... args) {
+  basic_error<Alloc>& out_of_memory = __out_of_memory_error<Alloc>();
+  basic_error<Alloc>* e = __new_error(alloc);
+  if (e == nullptr) {
+    return __hand_out_of_memory_error(out_of_memory);
+  }
+
+  if (!e->__append(type, size, fmt, args...)) {
+    basic_error_deleter<Alloc>()(e);
+    return __hand_out_of_memory_error(out_of_memory);
+  }
+  return basic_error_ptr<Alloc>(e);
+}
+
+// The function make_error can be used to create a new error.
+// It provides a signature that feels like printf. It creates
+// a generic_error with the default_error_message_size limit.
+template <typename... Args>
+__CPP_ERRORS_COLD inline error make_error(const char* fmt, Args... args) {
+  return allocate_error(std::allocator<char>(), err_type::generic_error, default_error_message_size, fmt, args...);
+}
+
+// The function make_serror can be used to create errors of type
+// generic_error with a specific message size limit. Please notice
+// that the limit will not be inherited to the following errors
+// that get appended to the base error object returned by this
+// function.
+template <typename... Args>
+__CPP_ERRORS_COLD inline error make_serror(std::size_t size, const char* fmt, Args... args) {
+  return allocate_error(std::allocator<char>(), err_type::generic_error, size, fmt, args...);
+}
+
+// The function make_terror can be used to create errors of a
+// specific type with the default message size limit. The type
+// does not get inherited by the appended messages to the object
+// returned by this function.
+template <typename... Args>
+__CPP_ERRORS_COLD inline error make_terror(err_type type, const char* fmt, Args... args) {
+  return allocate_error(std::allocator<char>(), type, default_error_message_size, fmt, args...);
+}
+
+// The function make_tserror can be used to create errors of
+// a specific type with a specific message size limit. These
+// specific values do not get inherited by the appended error
+// couples to the object returned by this function.
+template <typename... Args>
+__CPP_ERRORS_COLD inline error make_tserror(err_type type, std::size_t size, const char* fmt, Args... args) {
+  return allocate_error(std::allocator<char>(), type, size, fmt, args...);
+}
+
+// The function make_error<E> creates an error of type E with the
+// compile-time policies of error_traits<E>, e.g.
+//
+// return errors::make_error<errors::err_type::timed_out>("no reply from %s", host);
+//
+// formats into a buffer of error_traits<timed_out>::message_size bytes
+// on the stack, without any runtime size handling. For types whose
+// traits ask for it, the location of the caller is recorded in the
+// couple, and types which don't store messages skip formatting entirely.
+template <err_type E, typename... Args>
+__CPP_ERRORS_COLD inline error make_error(__located_format fmt, Args... args) {
+  __error& out_of_memory = __out_of_memory_error<std::allocator<char>>();
+  __error* e = __new_error(std::allocator<char>());
+  if (e == nullptr) {
+    return __hand_out_of_memory_error(out_of_memory);
+  }
+
+  if (!e->template __append_static<E>(fmt.location, fmt.fmt, args...)) {
+    delete e;
+    return __hand_out_of_memory_error(out_of_memory);
+  }
+  return error(e);
+}
+
+// The function is reports whether any couple of err has the type type.
+// It doesn't look at the couples, so it takes constant time no matter
+// how long the chain is.
+template <typename Alloc>
+inline bool is(const basic_error<Alloc>& err, err_type type) {
+  return err.types().contains(type);
+}
+
+template <typename Alloc>
+inline bool is(const basic_error_ptr<Alloc>& err, err_type type) {
+  return err && is(*err, type);
+}
+
+// The function in_category reports whether any couple of err has a
+// type of the category c, e.g.
+//
+// if (errors::in_category(err, errors::error_category::network)) {
+//   reconnect();
+// }
+template <typename Alloc>
+inline bool in_category(const basic_error<Alloc>& err, error_category c) {
+  return err.types().intersects(types_of(c));
+}
+
+template <typename Alloc>
+inline bool in_category(const basic_error_ptr<Alloc>& err, error_category c) {
+  return err && in_category(*err, c);
+}
+
+// The function is_retryable reports whether retrying the operation
+// which failed with err may succeed: the chain has a retryable type and
+// no permanent one.
+template <typename Alloc>
+inline bool is_retryable(const basic_error<Alloc>& err) {
+  return err.types().intersects(retryable_types) && !in_category(err, error_category::permanent);
+}
+
+template <typename Alloc>
+inline bool is_retryable(const basic_error_ptr<Alloc>& err) {
+  return err && is_retryable(*err);
+}
+}  // namespace errors
@@ -0,0 +1,93 @@
+/*
+MIT License
+
+Copyright (c) 2022 Danis Ozdemir
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+// cpp_errors_fwd.h declares the types of the library without defining
+// them. Headers which only pass errors and results around can include
+// it instead of cpp_errors.h and cpp_results.h.
+
+#include <memory>
+
+#ifdef __DEFINE_ERROR_T
+#error __DEFINE_ERROR_T is defined elsewwhere
+#endif
+
+#ifdef __DEFINE_ERROR_TRAITS
+#error __DEFINE_ERROR_TRAITS is defined elsewhere
+#endif
+
+#ifdef __DEFINE_ERROR_CATEGORY
+#error __DEFINE_ERROR_CATEGORY is defined elsewhere
+#endif
+
+#ifdef __DEFINE_ERROR_CATEGORY_MEMBER
+#error __DEFINE_ERROR_CATEGORY_MEMBER is defined elsewhere
+#endif
+
+namespace errors {
+// err_type enum encapsulates the types of errors.
+enum class err_type {
+#define __DEFINE_ERROR_T(e) e,
+#include <error_types/predefined_errors.h>
+#include <error_types/user_defined_errors.h>
+#undef __DEFINE_ERROR_T
+};
+
+// Forward declaration of basic_error to define error types.
+// Alloc decides where the couples and their messages live.
+template <typename Alloc>
+class basic_error;
+
+// basic_error_deleter releases a basic_error through its allocator,
+// unless it's the preallocated error handed out when memory runs out.
+template <typename Alloc>
+struct basic_error_deleter {
+  void operator()(basic_error<Alloc>* e) const noexcept;
+};
+
+// basic_error_ptr is the owning pointer of a basic_error.
+template <typename Alloc>
+using basic_error_ptr = std::unique_ptr<basic_error<Alloc>, basic_error_deleter<Alloc>>;
+
+// __error is the basic_error which allocates from the heap.
+typedef basic_error<std::allocator<char>> __error;
+typedef basic_error_deleter<std::allocator<char>> error_deleter;
+
+// 'error' is a std::unique_ptr that encapsulates a vector of
+// error couples and functions to modify them.
+typedef basic_error_ptr<std::allocator<char>> error;
+
+// shared_error is an immutable, reference counted error which can be
+// copied cheaply, see cpp_shared_errors.h.
+class shared_error;
+}  // namespace errors
+
+namespace results {
+template <typename T>
+class result;
+
+template <typename T>
+class result_pair;
+}  // namespace results
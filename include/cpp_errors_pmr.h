@@ -0,0 +1,80 @@
+/*
+MIT License
+
+Copyright (c) 2022 Danis Ozdemir
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include <cpp_errors.h>
+#include <memory_resource>
+
+namespace errors {
+namespace pmr {
+// errors::pmr::error is an error whose object, couples and messages
+// are all allocated from a std::pmr::memory_resource given at creation,
+// and which gives its memory back to that resource when destroyed.
+// It's meant for code running on per-request arenas, where every error
+// of a request comes from the request's memory resource:
+//
+// std::pmr::monotonic_buffer_resource arena(buffer, sizeof(buffer));
+// errors::pmr::error err = errors::pmr::make_error(&arena, "%s - bad input", code_location());
+// err->append("while handling request %d", id);
+//
+// Please notice that the errors have to be destroyed before the
+// resource is released, just like any other object living in it.
+typedef std::pmr::polymorphic_allocator<char> allocator_type;
+typedef basic_error<allocator_type> __error;
+typedef basic_error_couple<allocator_type> error_couple;
+typedef basic_error_ptr<allocator_type> error;
+
+// The function make_error creates a generic_error with the
+// default_error_message_size limit in resource.
+template <typename... Args>
+__CPP_ERRORS_COLD inline error make_error(std::pmr::memory_resource* resource, const char* fmt, Args... args) {
+  return allocate_error(allocator_type(resource), err_type::generic_error, default_error_message_size, fmt, args...);
+}
+
+// The function make_serror creates a generic_error with a specific
+// message size limit in resource.
+template <typename... Args>
+__CPP_ERRORS_COLD inline error make_serror(std::pmr::memory_resource* resource, std::size_t size, const char* fmt,
+                                           Args... args) {
+  return allocate_error(allocator_type(resource), err_type::generic_error, size, fmt, args...);
+}
+
+// The function make_terror creates an error of a specific type with
+// the default message size limit in resource.
+template <typename... Args>
+__CPP_ERRORS_COLD inline error make_terror(std::pmr::memory_resource* resource, err_type type, const char* fmt,
+                                           Args... args) {
+  return allocate_error(allocator_type(resource), type, default_error_message_size, fmt, args...);
+}
+
+// The function make_tserror creates an error of a specific type with
+// a specific message size limit in resource.
+template <typename... Args>
+__CPP_ERRORS_COLD inline error make_tserror(std::pmr::memory_resource* resource, err_type type, std::size_t size,
+                                            const char* fmt, Args... args) {
+  return allocate_error(allocator_type(resource), type, size, fmt, args...);
+}
+}  // namespace pmr
+}  // namespace errors
@@ -0,0 +1,279 @@
+/*
+MIT License
+
+Copyright (c) 2022 Danis Ozdemir
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include <cpp_errors.h>
+#include <sys/uio.h>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <ostream>
+#include <string_view>
+
+namespace errors {
+// The functions below write an error chain out as one line per couple:
+//
+// <type>: <message>
+// <type>: <message> [<file>:<line> - <function>]
+// <type>: <message> (x<repeats>)
+//
+// where the second form is used for couples with a captured location,
+// and the third for coalesced duplicates, after the location if any.
+// Where couples were dropped to keep the error within its budget, a
+//
+// ... <count> couples dropped
+//
+// line takes their place.
+// They read the messages and the type names where they are, so none
+// of them allocates. Fields are not part of the output, they can be
+// rendered separately with fields_text or fields_json.
+
+// render(fd) collects up to render_batch_iovecs pieces on the stack
+// before calling writev, well below the 1024 iovecs which Linux
+// accepts, so that its stack stays around 4 KB. A couple is made of
+// 4 pieces without a location, repeats and dropped couples, and of up
+// to 17 pieces with all of them.
+inline constexpr std::size_t render_batch_iovecs = 128;
+inline constexpr std::size_t render_min_pieces_per_couple = 4;
+inline constexpr std::size_t render_max_pieces_per_couple = 17;
+// A batch is written once the next couple might not fit in it, so the
+// couples of a batch are at most 28 plain ones, or 7 with every piece.
+inline constexpr std::size_t render_batch_couples =
+    (render_batch_iovecs - render_max_pieces_per_couple) / render_min_pieces_per_couple + 1;
+inline constexpr char render_separator[] = ": ";
+inline constexpr char render_location_start[] = " [";
+inline constexpr char render_line_separator[] = ":";
+inline constexpr char render_function_separator[] = " - ";
+inline constexpr char render_location_end[] = "]";
+inline constexpr char render_repeats_start[] = " (x";
+inline constexpr char render_repeats_end[] = ")";
+inline constexpr char render_newline[] = "\n";
+inline constexpr char render_dropped_start[] = "... ";
+inline constexpr char render_dropped_end[] = " couples dropped\n";
+
+// __couple_scratch holds the numbers rendered for a couple, which have
+// no storage of their own.
+struct __couple_scratch {
+  char line[16];
+  char repeats[24];
+  char dropped[24];
+};
+
+// __out_of_memory_couple stands in for the couple the preallocated
+// error doesn't store.
+struct __out_of_memory_couple {
+  err_type type = err_type::not_enough_memory;
+  std::string_view message = __out_of_memory_message;
+  error_location location;
+  std::size_t repeats = 1;
+};
+
+// The function __dropped_before returns how many couples were dropped
+// right before the couple at index, if any.
+template <typename Alloc>
+inline std::size_t __dropped_before(const basic_error<Alloc>& err, std::size_t index) {
+  return err.dropped() > 0 && index == err.dropped_at() ? err.dropped() : 0;
+}
+
+// The function __for_each_piece calls f(data, length) for each piece of
+// the rendered couple, in order, preceded by the line of the dropped
+// couples if dropped isn't 0. The pieces point either at the couple or
+// at scratch.
+template <typename Couple, typename F>
+inline void __for_each_piece(const Couple& couple, std::size_t dropped, __couple_scratch& scratch, F&& f) {
+  if (dropped > 0) {
+    int dropped_length = snprintf(scratch.dropped, sizeof(scratch.dropped), "%zu", dropped);
+    f(render_dropped_start, sizeof(render_dropped_start) - 1);
+    f(scratch.dropped, static_cast<std::size_t>(dropped_length));
+    f(render_dropped_end, sizeof(render_dropped_end) - 1);
+  }
+
+  const char* type_name = c_str(couple.type);
+  f(type_name, strlen(type_name));
+  f(render_separator, sizeof(render_separator) - 1);
+  f(couple.message.data(), couple.message.size());
+
+  if (couple.location) {
+    int line_length = snprintf(scratch.line, sizeof(scratch.line), "%d", couple.location.line);
+    f(render_location_start, sizeof(render_location_start) - 1);
+    f(couple.location.file, strlen(couple.location.file));
+    f(render_line_separator, sizeof(render_line_separator) - 1);
+    f(scratch.line, static_cast<std::size_t>(line_length));
+    f(render_function_separator, sizeof(render_function_separator) - 1);
+    f(couple.location.function, strlen(couple.location.function));
+    f(render_location_end, sizeof(render_location_end) - 1);
+  }
+
+  if (couple.repeats > 1) {
+    int repeats_length = snprintf(scratch.repeats, sizeof(scratch.repeats), "%zu", couple.repeats);
+    f(render_repeats_start, sizeof(render_repeats_start) - 1);
+    f(scratch.repeats, static_cast<std::size_t>(repeats_length));
+    f(render_repeats_end, sizeof(render_repeats_end) - 1);
+  }
+
+  f(render_newline, sizeof(render_newline) - 1);
+}
+
+// The function __for_each_piece calls f(data, length) for each piece of
+// the rendered chain of err, in order.
+template <typename Alloc, typename F>
+inline void __for_each_piece(const basic_error<Alloc>& err, F&& f) {
+  __couple_scratch scratch;
+  if (err.preallocated()) {
+    __for_each_piece(__out_of_memory_couple(), 0, scratch, f);
+    return;
+  }
+
+  std::size_t index = 0;
+  for (const auto& couple : err.couples()) {
+    __for_each_piece(couple, __dropped_before(err, index++), scratch, f);
+  }
+}
+
+// The function __writev_all writes count iovecs to fd, resuming after
+// partial writes and interruptions. It returns the number of bytes
+// written, or -1 with errno set.
+inline ssize_t __writev_all(int fd, struct iovec* iov, std::size_t count) {
+  ssize_t total = 0;
+  while (count > 0) {
+    ssize_t written = writev(fd, iov, static_cast<int>(count));
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return -1;
+    }
+    total += written;
+
+    std::size_t left = static_cast<std::size_t>(written);
+    while (count > 0 && left >= iov->iov_len) {
+      left -= iov->iov_len;
+      ++iov;
+      --count;
+    }
+    if (count > 0) {
+      iov->iov_base = static_cast<char*>(iov->iov_base) + left;
+      iov->iov_len -= left;
+    }
+  }
+  return total;
+}
+
+// The function render writes the chain of err to the file descriptor
+// fd. The iovecs point at the messages and the static type names, and
+// one writev call is made per render_batch_couples couples at most. It
+// returns the number of bytes written, or -1 with errno set.
+template <typename Alloc>
+inline ssize_t render(int fd, const basic_error<Alloc>& err) {
+  struct iovec iov[render_batch_iovecs];
+  __couple_scratch scratch[render_batch_couples];
+  std::size_t count = 0;
+  std::size_t couples = 0;
+  std::size_t index = 0;
+  ssize_t total = 0;
+  auto add_piece = [&iov, &count](const char* data, std::size_t length) {
+    iov[count].iov_base = const_cast<char*>(data);
+    iov[count].iov_len = length;
+    ++count;
+  };
+
+  if (err.preallocated()) {
+    __for_each_piece(__out_of_memory_couple(), 0, scratch[0], add_piece);
+    return __writev_all(fd, iov, count);
+  }
+
+  for (const auto& couple : err.couples()) {
+    if (count + render_max_pieces_per_couple > render_batch_iovecs) {
+      ssize_t written = __writev_all(fd, iov, count);
+      if (written < 0) {
+        return -1;
+      }
+      total += written;
+      count = 0;
+      couples = 0;
+    }
+
+    __for_each_piece(couple, __dropped_before(err, index++), scratch[couples++], add_piece);
+  }
+
+  ssize_t written = __writev_all(fd, iov, count);
+  return written < 0 ? -1 : total + written;
+}
+
+// The function render writes the chain of err to the output stream os.
+template <typename Alloc>
+inline std::ostream& render(std::ostream& os, const basic_error<Alloc>& err) {
+  __for_each_piece(err, [&os](const char* data, std::size_t length) {
+    os.write(data, static_cast<std::streamsize>(length));
+  });
+  return os;
+}
+
+// The function render_to copies the chain of err to the output
+// iterator out, e.g. std::back_inserter of a string, and returns the
+// iterator past the last character written.
+template <typename Alloc, typename OutputIt>
+inline OutputIt render_to(OutputIt out, const basic_error<Alloc>& err) {
+  __for_each_piece(err, [&out](const char* data, std::size_t length) {
+    for (std::size_t i = 0; i < length; ++i) {
+      *out++ = data[i];
+    }
+  });
+  return out;
+}
+
+// render_result describes what render wrote to a caller supplied buffer.
+struct render_result {
+  // The number of characters written, excluding the terminating '\0'.
+  std::size_t length;
+  // Whether the chain was cut short to fit into the buffer.
+  bool truncated;
+};
+
+// The function render writes as much of the chain of err as fits into
+// buffer, always terminating it with '\0' if size is not zero.
+template <typename Alloc>
+inline render_result render(char* buffer, std::size_t size, const basic_error<Alloc>& err) {
+  render_result result{0, false};
+  std::size_t room = size > 0 ? size - 1 : 0;
+
+  __for_each_piece(err, [&](const char* data, std::size_t length) {
+    std::size_t n = length;
+    if (n > room - result.length) {
+      n = room - result.length;
+      result.truncated = true;
+    }
+    if (n > 0) {
+      memcpy(buffer + result.length, data, n);
+      result.length += n;
+    }
+  });
+
+  if (size > 0) {
+    buffer[result.length] = '\0';
+  }
+  return result;
+}
+}  // namespace errors
@@ -0,0 +1,344 @@
+/*
+MIT License
+
+Copyright (c) 2022 Danis Ozdemir
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include <cpp_errors.h>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <iterator>
+#include <new>
+#include <string_view>
+#include <utility>
+
+namespace errors {
+// __frozen_header starts the single block of a frozen_error. It's
+// followed by couple_count __frozen_entry objects and then by the
+// messages, packed one after the other, each ending with a '\0'.
+struct __frozen_header {
+  std::size_t size;
+  std::uint32_t couple_count;
+  bool preallocated;
+  err_type_set types;
+  // Whether the block takes part in the process-wide accounting.
+  bool accounted;
+};
+
+// __frozen_entry describes one couple of a frozen_error. The offset of
+// its message is counted from the start of the block.
+struct __frozen_entry {
+  err_type type;
+  std::uint32_t offset;
+  std::uint32_t length;
+};
+
+// frozen_couple is the view of a couple of a frozen_error. The message
+// points into the block of the error and is '\0' terminated.
+struct frozen_couple {
+  err_type type;
+  std::string_view message;
+};
+
+// frozen_couples is the range of the couples of a frozen_error, with
+// the usual begin, end, size and operator[] functions. Its iterator is
+// an input iterator, as the couples it yields are views built on the
+// fly rather than objects in the block.
+class frozen_couples {
+ public:
+  class iterator {
+   public:
+    typedef std::input_iterator_tag iterator_category;
+    typedef frozen_couple value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef void pointer;
+    typedef frozen_couple reference;
+
+    iterator(const unsigned char* block, const __frozen_entry* entry) : m_block(block), m_entry(entry) {}
+
+    frozen_couple operator*() const {
+      return frozen_couple{m_entry->type,
+                           std::string_view(reinterpret_cast<const char*>(m_block + m_entry->offset), m_entry->length)};
+    }
+
+    iterator& operator++() {
+      ++m_entry;
+      return *this;
+    }
+
+    iterator operator++(int) {
+      iterator previous = *this;
+      ++m_entry;
+      return previous;
+    }
+
+    bool operator==(const iterator& other) const { return m_entry == other.m_entry; }
+    bool operator!=(const iterator& other) const { return m_entry != other.m_entry; }
+
+   private:
+    const unsigned char* m_block;
+    const __frozen_entry* m_entry;
+  };
+
+  frozen_couples(const unsigned char* block, const __frozen_entry* entries, std::size_t count)
+      : m_block(block), m_entries(entries), m_count(count) {}
+
+  iterator begin() const { return iterator(m_block, m_entries); }
+  iterator end() const { return iterator(m_block, m_entries + m_count); }
+  std::size_t size() const { return m_count; }
+  bool empty() const { return m_count == 0; }
+  frozen_couple operator[](std::size_t i) const { return *iterator(m_block, m_entries + i); }
+
+ private:
+  const unsigned char* m_block;
+  const __frozen_entry* m_entries;
+  std::size_t m_count;
+};
+
+// frozen_error is an immutable error whose whole chain lives in a
+// single allocation: a header, an array of {type, offset, length}
+// entries and the packed messages. Freezing an error allocates once,
+// copying a frozen error (or calling clone) allocates once and copies
+// the block with a single memcpy, and walking the couples reads one
+// contiguous block. It's the form to use when an error has to be
+// handed to several consumers, e.g. to a logger and to the caller:
+//
+// errors::frozen_error frozen(*err);
+// logger.push(frozen.clone());
+// return frozen;
+//
+// Only the types and the messages of the couples are kept; locations,
+// repeat counts and fields are left behind. When memory runs out, the
+// frozen error holds a preallocated not_enough_memory couple instead,
+// like errors::error does.
+class frozen_error {
+ public:
+  frozen_error() noexcept = default;
+  frozen_error(std::nullptr_t) noexcept {}
+
+  template <typename Alloc>
+  explicit frozen_error(const basic_error<Alloc>& err) : m_block(__freeze(err)) {}
+
+  template <typename Alloc>
+  explicit frozen_error(const basic_error_ptr<Alloc>& err) : m_block(err ? __freeze(*err) : nullptr) {}
+
+  frozen_error(const frozen_error& other) : m_block(other.__clone_block()) {}
+  frozen_error(frozen_error&& other) noexcept : m_block(std::exchange(other.m_block, nullptr)) {}
+
+  frozen_error& operator=(frozen_error other) noexcept {
+    std::swap(m_block, other.m_block);
+    return *this;
+  }
+
+  ~frozen_error() { release(); }
+
+  explicit operator bool() const noexcept { return m_block != nullptr; }
+  bool operator==(std::nullptr_t) const noexcept { return m_block == nullptr; }
+  bool operator!=(std::nullptr_t) const noexcept { return m_block != nullptr; }
+
+  // The function clone returns a deep copy, made with one allocation
+  // and one memcpy.
+  frozen_error clone() const { return *this; }
+
+  // The functions below work like those of errors::error.
+  std::string_view message() const {
+    if (m_block == nullptr || __header()->couple_count == 0) {
+      __report_empty_error("message");
+      return std::string_view();
+    }
+    return couples()[0].message;
+  }
+
+  err_type type() const {
+    if (m_block == nullptr || __header()->couple_count == 0) {
+      __report_empty_error("type");
+      return err_type::generic_error;
+    }
+    return __entries()->type;
+  }
+
+  const char* cmessage() const {
+    if (m_block == nullptr || __header()->couple_count == 0) {
+      __report_empty_error("cmessage");
+      return "";
+    }
+    return reinterpret_cast<const char*>(m_block + __entries()->offset);
+  }
+
+  frozen_couples couples() const {
+    if (m_block == nullptr) {
+      return frozen_couples(nullptr, nullptr, 0);
+    }
+    return frozen_couples(m_block, __entries(), __header()->couple_count);
+  }
+
+  const err_type_set& types() const {
+    static const err_type_set none;
+    return m_block != nullptr ? __header()->types : none;
+  }
+
+  bool preallocated() const { return m_block != nullptr && __header()->preallocated; }
+
+  // The function size_bytes returns the size of the single block.
+  std::size_t size_bytes() const { return m_block != nullptr ? __header()->size : 0; }
+
+  // The function to_error builds an errors::error with the same
+  // couples, which can be appended to again.
+  error to_error() const {
+    if (m_block == nullptr || __header()->couple_count == 0) {
+      return nullptr;
+    }
+    if (__header()->preallocated) {
+      return error(&__out_of_memory_error<std::allocator<char>>());
+    }
+
+    frozen_couples all = couples();
+    error err = make_tserror(all[0].type, all[0].message.size() + 1, "%s", all[0].message.data());
+    for (std::size_t i = 1; i < all.size(); i++) {
+      err->tsappend(all[i].type, all[i].message.size() + 1, "%s", all[i].message.data());
+    }
+    return err;
+  }
+
+ private:
+  unsigned char* m_block = nullptr;
+
+  const __frozen_header* __header() const { return reinterpret_cast<const __frozen_header*>(m_block); }
+
+  const __frozen_entry* __entries() const {
+    return reinterpret_cast<const __frozen_entry*>(m_block + sizeof(__frozen_header));
+  }
+
+  // The function __freeze lays the couples of err out in a new block.
+  // It returns the preallocated block if there is not enough memory for
+  // it, and no block at all for an error without couples, e.g. a moved
+  // from one, which to_error would turn into nullptr anyway.
+  template <typename Alloc>
+  static unsigned char* __freeze(const basic_error<Alloc>& err) {
+    unsigned char* out_of_memory = __out_of_memory_block();
+    if (err.preallocated()) {
+      return out_of_memory;
+    }
+    if (err.couples().empty()) {
+      return nullptr;
+    }
+
+    std::size_t size = __frozen_size(err.couples());
+    if (size > UINT32_MAX) {
+      return out_of_memory;
+    }
+
+    void* block = ::operator new(size, std::nothrow);
+    if (block == nullptr) {
+      return out_of_memory;
+    }
+    __write(static_cast<unsigned char*>(block), size, err.couples(), err.types(), false);
+    return __account(static_cast<unsigned char*>(block));
+  }
+
+  template <typename Couples>
+  static std::size_t __frozen_size(const Couples& couples) {
+    std::size_t size = sizeof(__frozen_header) + couples.size() * sizeof(__frozen_entry);
+    for (const auto& couple : couples) {
+      size += couple.message.size() + 1;
+    }
+    return size;
+  }
+
+  template <typename Couples>
+  static void __write(unsigned char* block, std::size_t size, const Couples& couples, const err_type_set& types,
+                      bool preallocated) {
+    new (block) __frozen_header{size, static_cast<std::uint32_t>(couples.size()), preallocated, types, false};
+    __frozen_entry* entries = reinterpret_cast<__frozen_entry*>(block + sizeof(__frozen_header));
+    std::size_t offset = sizeof(__frozen_header) + couples.size() * sizeof(__frozen_entry);
+    for (const auto& couple : couples) {
+      new (entries++) __frozen_entry{couple.type, static_cast<std::uint32_t>(offset),
+                                     static_cast<std::uint32_t>(couple.message.size())};
+      memcpy(block + offset, couple.message.data(), couple.message.size());
+      block[offset + couple.message.size()] = '\0';
+      offset += couple.message.size() + 1;
+    }
+  }
+
+  // The preallocated block is the frozen form of the preallocated
+  // error. It's written into static storage by the first failure, from
+  // constants rather than from the preallocated error, so it never
+  // needs memory.
+  static unsigned char* __out_of_memory_block() {
+    alignas(__frozen_header) static unsigned char block[sizeof(__frozen_header) + sizeof(__frozen_entry) + 64];
+    static const bool written = [] {
+      std::initializer_list<frozen_couple> out_of_memory = {{err_type::not_enough_memory, __out_of_memory_message}};
+      static_assert(sizeof(__out_of_memory_message) <= 64);
+      err_type_set types;
+      types.insert(err_type::not_enough_memory);
+      __write(block, __frozen_size(out_of_memory), out_of_memory, types, true);
+      return true;
+    }();
+    (void)written;
+    return block;
+  }
+
+  unsigned char* __clone_block() const {
+    if (m_block == nullptr || __header()->preallocated) {
+      return m_block;
+    }
+
+    void* block = ::operator new(__header()->size, std::nothrow);
+    if (block == nullptr) {
+      return __out_of_memory_block();
+    }
+    memcpy(block, m_block, __header()->size);
+    return __account(static_cast<unsigned char*>(block));
+  }
+
+  // Frozen errors take part in the process-wide accounting like other
+  // errors, if it's on when their block is created, see memory_stats.
+  static unsigned char* __account(unsigned char* block) {
+    __frozen_header* header = reinterpret_cast<__frozen_header*>(block);
+    header->accounted = __accounting_enabled();
+    if (header->accounted) {
+      __add(__error_memory.live_bytes, header->size);
+      __add(__error_memory.live_errors, 1);
+    }
+    return block;
+  }
+
+  void release() {
+    if (m_block != nullptr && !__header()->preallocated) {
+      if (__header()->accounted) {
+        __sub(__error_memory.live_bytes, __header()->size);
+        __sub(__error_memory.live_errors, 1);
+      }
+      ::operator delete(m_block);
+    }
+    m_block = nullptr;
+  }
+};
+
+// The functions is and in_category work like those of errors::error.
+inline bool is(const frozen_error& err, err_type type) { return err.types().contains(type); }
+
+inline bool in_category(const frozen_error& err, error_category c) { return err.types().intersects(types_of(c)); }
+}  // namespace errors
@@ -25,12 +25,28 @@ SOFTWARE.
 #pragma once
 
 #include <cpp_errors.h>
-#include <assert.h>
-#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <optional>
 #include <utility>
 #include <variant>
+#if __has_include(<version>)
+#include <version>
+#endif
+#if defined(__cpp_lib_expected)
+#include <expected>
+#endif
 
 namespace results {
+// The function __abort_on_misuse reports a call that breaks the
+// contract of result or result_pair and terminates the process.
+// It's kept out of line, so that the checks in the accessors stay
+// small.
+[[gnu::cold, gnu::noinline, noreturn]] inline void __abort_on_misuse(const char* message) {
+  fprintf(stderr, "%s\n", message);
+  std::abort();
+}
+
 // result can be thought of as a union (although it uses std::variant under the hood) that can contain either a real
 // result value or an error in a mutually exclusive manner. A simple use case would look like the following code block:
 //
@@ -60,32 +76,82 @@ class result {
   explicit result(T&& val) : m_variant(std::move(val)) {}
 
   explicit result(errors::error&& err) : m_variant(std::move(err)) {
-    if (std::get<errors::error>(m_variant).get() == nullptr) {
-      std::cerr << "Detected a NULL error when the result was not available" << std::endl;
-      assert(false);
+    if (__CPP_ERRORS_UNLIKELY(std::get<errors::error>(m_variant).get() == nullptr)) {
+      __abort_on_misuse("Detected a NULL error when the result was not available");
+    }
+  }
+
+  // The constructor below takes over the value of o. If o is empty,
+  // the result holds the error returned by make_err, which isn't called
+  // otherwise. The value is moved exactly once, e.g.
+  //
+  // results::result<user> r(cache.find(id), [id] { return errors::make_error("no user %d", id); });
+  template <typename F>
+  result(std::optional<T>&& o, F make_err) : m_variant(std::in_place_index<1>) {
+    if (o) {
+      m_variant.template emplace<0>(std::move(*o));
+    } else {
+      __set_error(make_err());
+    }
+  }
+
+#if defined(__cpp_lib_expected)
+  // The constructor below takes over the value or the error of e,
+  // moving the value exactly once.
+  explicit result(std::expected<T, errors::error>&& e) : m_variant(std::in_place_index<1>) {
+    if (e) {
+      m_variant.template emplace<0>(std::move(*e));
+    } else {
+      __set_error(std::move(e.error()));
+    }
+  }
+
+  // The function to_expected moves the value or the error into an
+  // std::expected, moving the value exactly once.
+  std::expected<T, errors::error> to_expected() && {
+    if (T* value = std::get_if<0>(&m_variant)) {
+      return std::expected<T, errors::error>(std::in_place, std::move(*value));
     }
+    return std::expected<T, errors::error>(std::unexpect, std::move(std::get<1>(m_variant)));
   }
+#endif
 
   result() = delete;
 
+  // The function to_optional moves the value into an std::optional. The
+  // optional is empty if the result holds an error, which is dropped.
+  std::optional<T> to_optional() && {
+    if (T* value = std::get_if<0>(&m_variant)) {
+      return std::optional<T>(std::in_place, std::move(*value));
+    }
+    return std::nullopt;
+  }
+
   errors::error error() {
-    if (std::holds_alternative<errors::error>(m_variant)) {
+    if (__CPP_ERRORS_UNLIKELY(std::holds_alternative<errors::error>(m_variant))) {
       return std::move(std::get<errors::error>(m_variant));
     }
     return nullptr;
   }
 
   T&& value() {
-    if (std::holds_alternative<T>(m_variant)) {
-      return std::move(std::get<T>(m_variant));
+    // value should only get called after making sure that err() returns nullptr.
+    // Misuse terminates the process in every build mode, rather than reading
+    // a value that isn't there.
+    if (__CPP_ERRORS_UNLIKELY(!std::holds_alternative<T>(m_variant))) {
+      __abort_on_misuse("Detected a call to value when the result was not set");
     }
-
-    // value should only get called after making sure that err() returns nullptr
-    std::cerr << "Detected a call to value when the result was not set" << std::endl;
-    assert(false);
+    return std::move(std::get<T>(m_variant));
   }
 
  private:
+  void __set_error(errors::error&& err) {
+    if (__CPP_ERRORS_UNLIKELY(err.get() == nullptr)) {
+      __abort_on_misuse("Detected a NULL error when the result was not available");
+    }
+    std::get<1>(m_variant) = std::move(err);
+  }
+
   std::variant<T, errors::error> m_variant;
 };
 
@@ -119,8 +185,8 @@ class result_pair : public std::pair<T, errors::error> {
   explicit result_pair(errors::error&& err)
       : std::pair<T, errors::error>(std::move(std::make_pair<T, errors::error>(T{}, std::move(err)))) {
     static_assert(!std::is_same<T, errors::error>());
-    if (this->second.get() == nullptr) {
-      assert(false);
+    if (__CPP_ERRORS_UNLIKELY(this->second.get() == nullptr)) {
+      __abort_on_misuse("Detected a NULL error when the result was not available");
     }
   }
 
@@ -128,5 +194,65 @@ class result_pair : public std::pair<T, errors::error> {
       : std::pair<T, errors::error>(std::move(std::make_pair<T, errors::error>(std::move(t), nullptr))) {
     static_assert(!std::is_same<T, errors::error>());
   }
+
+  // The constructor below takes over the value of o. If o is empty, the
+  // value is T{} and the error is the one returned by make_err, which
+  // isn't called otherwise. The value is moved exactly once.
+  template <typename F>
+  result_pair(std::optional<T>&& o, F make_err)
+      : std::pair<T, errors::error>(__value_of<std::optional<T>>{o}, o ? nullptr : make_err()) {
+    __check_error(o.has_value());
+  }
+
+#if defined(__cpp_lib_expected)
+  // The constructor below takes over the value or the error of e,
+  // moving the value exactly once.
+  explicit result_pair(std::expected<T, errors::error>&& e)
+      : std::pair<T, errors::error>(__value_of<std::expected<T, errors::error>>{e},
+                                    e ? nullptr : std::move(e.error())) {
+    __check_error(e.has_value());
+  }
+
+  // The function to_expected moves the value or the error into an
+  // std::expected, moving the value exactly once.
+  std::expected<T, errors::error> to_expected() && {
+    if (__CPP_ERRORS_UNLIKELY(this->second)) {
+      return std::expected<T, errors::error>(std::unexpect, std::move(this->second));
+    }
+    return std::expected<T, errors::error>(std::in_place, std::move(this->first));
+  }
+#endif
+
+  // The function to_optional moves the value into an std::optional. The
+  // optional is empty if there is an error, which is dropped.
+  std::optional<T> to_optional() && {
+    if (__CPP_ERRORS_UNLIKELY(this->second)) {
+      return std::nullopt;
+    }
+    return std::optional<T>(std::in_place, std::move(this->first));
+  }
+
+ private:
+  // __value_of converts to the value of an std::optional or an
+  // std::expected, or to T{} if it has none. Passing it to the pair
+  // constructor builds the value in place, with a single move.
+  template <typename Source>
+  struct __value_of {
+    Source& source;
+
+    operator T() const {
+      if (source) {
+        return std::move(*source);
+      }
+      return T{};
+    }
+  };
+
+  void __check_error(bool has_value) {
+    static_assert(!std::is_same<T, errors::error>());
+    if (__CPP_ERRORS_UNLIKELY(!has_value && this->second.get() == nullptr)) {
+      __abort_on_misuse("Detected a NULL error when the result was not available");
+    }
+  }
 };
 }  // namespace results
@@ -0,0 +1,217 @@
+/*
+MIT License
+
+Copyright (c) 2022 Danis Ozdemir
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include <cpp_errors.h>
+#include <cpp_results.h>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+namespace results {
+// retry_budget limits how much retrying a group of callers can do, so
+// that an outage doesn't turn into a retry storm. Every retry spends a
+// token and every success earns token_ratio of a token back, up to
+// max_tokens. It's safe to share between threads.
+class retry_budget {
+ public:
+  explicit retry_budget(std::size_t max_tokens, double token_ratio = 0.1)
+      : m_max(static_cast<std::int64_t>(max_tokens) * token_scale),
+        m_ratio(static_cast<std::int64_t>(token_ratio * token_scale)),
+        m_tokens(m_max) {}
+
+  // The function try_spend takes a token for a retry. It returns false
+  // if there is none left.
+  bool try_spend() {
+    std::int64_t tokens = m_tokens.load(std::memory_order_relaxed);
+    while (tokens >= token_scale) {
+      if (m_tokens.compare_exchange_weak(tokens, tokens - token_scale, std::memory_order_relaxed)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // The function earn adds token_ratio of a token after a success.
+  void earn() {
+    std::int64_t tokens = m_tokens.load(std::memory_order_relaxed);
+    while (tokens < m_max) {
+      std::int64_t earned = tokens + m_ratio < m_max ? tokens + m_ratio : m_max;
+      if (m_tokens.compare_exchange_weak(tokens, earned, std::memory_order_relaxed)) {
+        return;
+      }
+    }
+  }
+
+  // The function tokens returns the number of retries left right now.
+  double tokens() const { return static_cast<double>(m_tokens.load(std::memory_order_relaxed)) / token_scale; }
+
+ private:
+  static constexpr std::int64_t token_scale = 1000;
+
+  const std::int64_t m_max;
+  const std::int64_t m_ratio;
+  std::atomic<std::int64_t> m_tokens;
+};
+
+// retry_policy tells results::retry when and how long to wait before
+// trying again. The delay before the n-th retry is
+// initial_backoff * multiplier^(n - 1), capped at max_backoff, and
+// shortened by a random fraction of up to jitter, so that clients which
+// failed together don't retry together. A deadline of 0 means none.
+struct retry_policy {
+  std::size_t max_attempts = 3;
+  std::chrono::nanoseconds initial_backoff = std::chrono::milliseconds(10);
+  std::chrono::nanoseconds max_backoff = std::chrono::seconds(1);
+  double multiplier = 2.0;
+  double jitter = 0.2;
+  std::chrono::nanoseconds deadline = std::chrono::nanoseconds(0);
+  // Shared by all the callers which should retry within one budget, if
+  // not nullptr.
+  retry_budget* budget = nullptr;
+  // Decides whether an error is worth retrying, errors::is_retryable if
+  // nullptr.
+  bool (*retryable)(const errors::__error& err) = nullptr;
+  // Waits between the attempts, std::this_thread::sleep_for if nullptr.
+  void (*sleep)(std::chrono::nanoseconds delay) = nullptr;
+};
+
+// The functions below let retry work on result<T>, result_pair<T> and
+// on plain errors::error, taking the error out of a failed outcome and
+// building a failed outcome from an error.
+template <typename T>
+inline errors::error __take_error(result<T>& r) {
+  return r.error();
+}
+
+template <typename T>
+inline errors::error __take_error(result_pair<T>& r) {
+  return std::move(r.second);
+}
+
+inline errors::error __take_error(errors::error& err) { return std::move(err); }
+
+template <typename R>
+inline R __failed(errors::error&& err) {
+  if constexpr (std::is_same<R, errors::error>::value) {
+    return std::move(err);
+  } else {
+    return R(std::move(err));
+  }
+}
+
+// The function __jitter_fraction returns a pseudo random number in
+// [0, 1). Its state is per thread, so it needs no synchronization.
+inline double __jitter_fraction() {
+  thread_local std::uint64_t state =
+      static_cast<std::uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count()) ^
+      reinterpret_cast<std::uintptr_t>(&state);
+  state ^= state << 13;
+  state ^= state >> 7;
+  state ^= state << 17;
+  return static_cast<double>(state >> 11) / static_cast<double>(std::uint64_t(1) << 53);
+}
+
+// The function retry calls f until it succeeds or the policy says to
+// stop, and returns the last outcome. f returns a result<T>, a
+// result_pair<T> or an errors::error, which is nullptr on success. An
+// error ends the retries if it's not retryable, if max_attempts is
+// reached, if the next attempt would start after the deadline or if
+// the budget is spent. The final error gets one couple per earlier
+// failed attempt and a last one telling why retry gave up, e.g.
+//
+// results::retry_budget budget(100);
+// results::retry_policy policy;
+// policy.max_attempts = 5;
+// policy.budget = &budget;
+//
+// results::result<reply> r = results::retry(policy, [&] { return client.call(request); });
+template <typename F>
+auto retry(const retry_policy& policy, F&& f) -> decltype(f()) {
+  typedef decltype(f()) outcome_type;
+  typedef std::chrono::steady_clock clock;
+
+  const clock::time_point start = clock::now();
+  std::chrono::nanoseconds backoff = policy.initial_backoff;
+  errors::error attempts;
+
+  for (std::size_t attempt = 1;; attempt++) {
+    outcome_type outcome = f();
+    errors::error err = __take_error(outcome);
+    if (!err) {
+      if (policy.budget != nullptr) {
+        policy.budget->earn();
+      }
+      return outcome;
+    }
+
+    const char* reason = nullptr;
+    std::chrono::nanoseconds delay = backoff - std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                                   backoff * (policy.jitter * __jitter_fraction()));
+    if (!(policy.retryable != nullptr ? policy.retryable(*err) : errors::is_retryable(*err))) {
+      reason = "the error is not retryable";
+    } else if (attempt >= policy.max_attempts) {
+      reason = "no attempts left";
+    } else if (policy.deadline.count() > 0 && clock::now() + delay > start + policy.deadline) {
+      reason = "the deadline would pass";
+    } else if (policy.budget != nullptr && !policy.budget->try_spend()) {
+      reason = "the retry budget is spent";
+    }
+
+    if (reason != nullptr) {
+      if (attempts) {
+        for (const auto& couple : attempts->couples()) {
+          err->tsappend(couple.type, couple.message.size() + 1, "%s", couple.message.c_str());
+        }
+      }
+      err->append("gave up at attempt %zu: %s", attempt, reason);
+      return __failed<outcome_type>(std::move(err));
+    }
+
+    if (!attempts) {
+      attempts = errors::make_tserror(err->type(), errors::default_error_message_size, "attempt %zu failed: %s",
+                                      attempt, err->cmessage());
+    } else {
+      attempts->tappend(err->type(), "attempt %zu failed: %s", attempt, err->cmessage());
+    }
+    err = nullptr;
+
+    if (policy.sleep != nullptr) {
+      policy.sleep(delay);
+    } else {
+      std::this_thread::sleep_for(delay);
+    }
+
+    backoff = std::chrono::duration_cast<std::chrono::nanoseconds>(backoff * policy.multiplier);
+    if (backoff > policy.max_backoff) {
+      backoff = policy.max_backoff;
+    }
+  }
+}
+}  // namespace results
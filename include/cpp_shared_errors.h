@@ -0,0 +1,217 @@
+/*
+MIT License
+
+Copyright (c) 2022 Danis Ozdemir
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include <cpp_errors.h>
+#include <cstddef>
+#include <new>
+#include <utility>
+
+namespace errors {
+// shared_error is an immutable snapshot of an error, with an intrusive,
+// atomic reference count kept by the error itself. Copying it only bumps
+// the count, so a single failure can be handed to any number of waiters,
+// on any number of threads, without building a new error for each of
+// them:
+//
+// errors::shared_error failure(errors::make_error("connection pool is down"));
+// for (auto& waiter : waiters) {
+//   waiter.fail(failure);
+// }
+//
+// A waiter which wants to add its own context appends to its copy,
+// which gets a private error of its own first (copy on write), leaving
+// every other copy untouched. Converting from errors::error takes the
+// error over without allocating, and so does converting back when the
+// shared_error is the only owner.
+class shared_error {
+ public:
+  shared_error() noexcept = default;
+  shared_error(std::nullptr_t) noexcept {}
+
+  // The constructor takes over err, the error itself is shared.
+  explicit shared_error(error&& err) noexcept {
+    if (!err) {
+      return;
+    }
+
+    // The preallocated error has to outlive every shared_error.
+    __out_of_memory_error<std::allocator<char>>();
+    m_error = err.release();
+    m_error->__share();
+  }
+
+  shared_error(const shared_error& other) noexcept : m_error(other.m_error) {
+    if (m_error != nullptr) {
+      m_error->__share();
+    }
+  }
+
+  shared_error(shared_error&& other) noexcept : m_error(other.m_error) { other.m_error = nullptr; }
+
+  shared_error& operator=(shared_error other) noexcept {
+    std::swap(m_error, other.m_error);
+    return *this;
+  }
+
+  ~shared_error() { release(); }
+
+  explicit operator bool() const noexcept { return m_error != nullptr; }
+
+  bool operator==(std::nullptr_t) const noexcept { return m_error == nullptr; }
+  bool operator!=(std::nullptr_t) const noexcept { return m_error != nullptr; }
+
+  // The shared error can only be read through a shared_error.
+  const __error* get() const noexcept { return m_error; }
+  const __error* operator->() const noexcept { return get(); }
+  const __error& operator*() const noexcept { return *m_error; }
+
+  // The function use_count returns the number of shared_error objects
+  // sharing the same error. It's only a hint when other threads hold
+  // copies too.
+  std::size_t use_count() const noexcept { return m_error != nullptr ? m_error->__shared_count() : 0; }
+
+  // The function to_error returns an errors::error with the same couples.
+  // The rvalue overload hands the error itself over, if this is the only
+  // owner, and leaves this shared_error empty.
+  error to_error() const& {
+    if (m_error == nullptr) {
+      return nullptr;
+    }
+    return __make_owned(__copy(*m_error));
+  }
+
+  error to_error() && {
+    if (m_error == nullptr) {
+      return nullptr;
+    }
+
+    __error* e;
+    if (!m_error->preallocated() && unique()) {
+      m_error->__unshare();
+      e = m_error;
+      m_error = nullptr;
+    } else {
+      e = __copy(*m_error);
+      release();
+    }
+    return __make_owned(e);
+  }
+
+  // The append functions work like those of errors::error. The couple
+  // is added to this shared_error only, which gets a private copy of
+  // the couples first, if they're shared with others.
+  template <typename... Args>
+  void append(const char* fmt, Args... args) {
+    if (__make_unique()) {
+      m_error->append(fmt, args...);
+    }
+  }
+
+  template <typename... Args>
+  void sappend(std::size_t size, const char* fmt, Args... args) {
+    if (__make_unique()) {
+      m_error->sappend(size, fmt, args...);
+    }
+  }
+
+  template <typename... Args>
+  void tappend(err_type type, const char* fmt, Args... args) {
+    if (__make_unique()) {
+      m_error->tappend(type, fmt, args...);
+    }
+  }
+
+  template <typename... Args>
+  void tsappend(err_type type, std::size_t size, const char* fmt, Args... args) {
+    if (__make_unique()) {
+      m_error->tsappend(type, size, fmt, args...);
+    }
+  }
+
+  // The function add_field adds a field to this shared_error only, in
+  // the same copy on write fashion.
+  template <typename T>
+  shared_error& add_field(const char* key, const T& value) {
+    if (__make_unique()) {
+      m_error->add_field(key, value);
+    }
+    return *this;
+  }
+
+ private:
+  __error* m_error = nullptr;
+
+  // The function __copy returns a copy of err, or nullptr when there
+  // is not enough memory for it. The preallocated error isn't copied.
+  static __error* __copy(const __error& err) {
+    __error* copy = nullptr;
+    if (err.preallocated() || !err.__can_copy()) {
+      return nullptr;
+    }
+    __CPP_ERRORS_TRY { copy = new (std::nothrow) __error(err); }
+    __CPP_ERRORS_CATCH_BAD_ALLOC {}
+    return copy;
+  }
+
+  static error __make_owned(__error* e) {
+    if (e == nullptr) {
+      return error(&__out_of_memory_error<std::allocator<char>>());
+    }
+    return error(e);
+  }
+
+  bool unique() const { return m_error->__shared_count() == 1; }
+
+  // The function __make_unique makes sure that this shared_error is the
+  // only owner of its error, copying the couples if necessary. It
+  // returns false if there is nothing that could be appended to.
+  bool __make_unique() {
+    if (m_error == nullptr || m_error->preallocated()) {
+      return false;
+    }
+
+    if (!unique()) {
+      __error* copy = __copy(*m_error);
+      release();
+      m_error = copy != nullptr ? copy : &__out_of_memory_error<std::allocator<char>>();
+      m_error->__share();
+    }
+    return !m_error->preallocated();
+  }
+
+  void release() {
+    if (m_error != nullptr && m_error->__unshare()) {
+      error_deleter()(m_error);
+    }
+    m_error = nullptr;
+  }
+};
+
+// The functions is and in_category work like those of errors::error.
+inline bool is(const shared_error& err, err_type type) { return err && is(*err, type); }
+
+inline bool in_category(const shared_error& err, error_category c) { return err && in_category(*err, c); }
+}  // namespace errors
@@ -0,0 +1,130 @@
+/*
+MIT License
+
+Copyright (c) 2022 Danis Ozdemir
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// The categories group the error types defined in predefined_errors.h.
+// A category is defined via __DEFINE_ERROR_CATEGORY and its types are
+// added via __DEFINE_ERROR_CATEGORY_MEMBER, after the category is
+// defined. A type can belong to any number of categories.
+
+#ifndef __DEFINE_ERROR_CATEGORY
+#error __DEFINE_ERROR_CATEGORY should have been defined, before including this header.
+#endif
+
+#ifndef __DEFINE_ERROR_CATEGORY_MEMBER
+#error __DEFINE_ERROR_CATEGORY_MEMBER should have been defined, before including this header.
+#endif
+
+// Failures of connections and of the network itself
+__DEFINE_ERROR_CATEGORY(network)
+__DEFINE_ERROR_CATEGORY_MEMBER(network, address_family_not_supported)
+__DEFINE_ERROR_CATEGORY_MEMBER(network, address_in_use)
+__DEFINE_ERROR_CATEGORY_MEMBER(network, address_not_available)
+__DEFINE_ERROR_CATEGORY_MEMBER(network, already_connected)
+__DEFINE_ERROR_CATEGORY_MEMBER(network, broken_pipe)
+__DEFINE_ERROR_CATEGORY_MEMBER(network, connection_aborted)
+__DEFINE_ERROR_CATEGORY_MEMBER(network, connection_already_in_progress)
+__DEFINE_ERROR_CATEGORY_MEMBER(network, connection_refused)
+__DEFINE_ERROR_CATEGORY_MEMBER(network, connection_reset)
+__DEFINE_ERROR_CATEGORY_MEMBER(network, destination_address_required)
+__DEFINE_ERROR_CATEGORY_MEMBER(network, host_unreachable)
+__DEFINE_ERROR_CATEGORY_MEMBER(network, network_down)
+__DEFINE_ERROR_CATEGORY_MEMBER(network, network_reset)
+__DEFINE_ERROR_CATEGORY_MEMBER(network, network_unreachable)
+__DEFINE_ERROR_CATEGORY_MEMBER(network, not_a_socket)
+__DEFINE_ERROR_CATEGORY_MEMBER(network, not_connected)
+__DEFINE_ERROR_CATEGORY_MEMBER(network, no_protocol_option)
+__DEFINE_ERROR_CATEGORY_MEMBER(network, protocol_error)
+__DEFINE_ERROR_CATEGORY_MEMBER(network, protocol_not_supported)
+__DEFINE_ERROR_CATEGORY_MEMBER(network, wrong_protocol_type)
+
+// Problems with files, directories and file systems
+__DEFINE_ERROR_CATEGORY(filesystem)
+__DEFINE_ERROR_CATEGORY_MEMBER(filesystem, already_exists)
+__DEFINE_ERROR_CATEGORY_MEMBER(filesystem, bad_file_descriptor)
+__DEFINE_ERROR_CATEGORY_MEMBER(filesystem, cross_device_link)
+__DEFINE_ERROR_CATEGORY_MEMBER(filesystem, directory_not_empty)
+__DEFINE_ERROR_CATEGORY_MEMBER(filesystem, file_too_large)
+__DEFINE_ERROR_CATEGORY_MEMBER(filesystem, filename_too_long)
+__DEFINE_ERROR_CATEGORY_MEMBER(filesystem, io_error)
+__DEFINE_ERROR_CATEGORY_MEMBER(filesystem, is_a_directory)
+__DEFINE_ERROR_CATEGORY_MEMBER(filesystem, no_space_left_on_device)
+__DEFINE_ERROR_CATEGORY_MEMBER(filesystem, no_such_file_or_directory)
+__DEFINE_ERROR_CATEGORY_MEMBER(filesystem, not_a_directory)
+__DEFINE_ERROR_CATEGORY_MEMBER(filesystem, read_only_file_system)
+__DEFINE_ERROR_CATEGORY_MEMBER(filesystem, text_file_busy)
+__DEFINE_ERROR_CATEGORY_MEMBER(filesystem, too_many_links)
+__DEFINE_ERROR_CATEGORY_MEMBER(filesystem, too_many_symbolic_link_levels)
+
+// Running out of memory, descriptors, buffers and the like
+__DEFINE_ERROR_CATEGORY(resource_exhaustion)
+__DEFINE_ERROR_CATEGORY_MEMBER(resource_exhaustion, no_buffer_space)
+__DEFINE_ERROR_CATEGORY_MEMBER(resource_exhaustion, no_space_left_on_device)
+__DEFINE_ERROR_CATEGORY_MEMBER(resource_exhaustion, no_stream_resources)
+__DEFINE_ERROR_CATEGORY_MEMBER(resource_exhaustion, not_enough_memory)
+__DEFINE_ERROR_CATEGORY_MEMBER(resource_exhaustion, too_many_files_open)
+__DEFINE_ERROR_CATEGORY_MEMBER(resource_exhaustion, too_many_files_open_in_system)
+
+// Missing rights
+__DEFINE_ERROR_CATEGORY(permission)
+__DEFINE_ERROR_CATEGORY_MEMBER(permission, operation_not_permitted)
+__DEFINE_ERROR_CATEGORY_MEMBER(permission, permission_denied)
+__DEFINE_ERROR_CATEGORY_MEMBER(permission, read_only_file_system)
+
+// Conditions which may go away by themselves
+__DEFINE_ERROR_CATEGORY(transient)
+__DEFINE_ERROR_CATEGORY_MEMBER(transient, connection_reset)
+__DEFINE_ERROR_CATEGORY_MEMBER(transient, device_or_resource_busy)
+__DEFINE_ERROR_CATEGORY_MEMBER(transient, interrupted)
+__DEFINE_ERROR_CATEGORY_MEMBER(transient, network_down)
+__DEFINE_ERROR_CATEGORY_MEMBER(transient, network_unreachable)
+__DEFINE_ERROR_CATEGORY_MEMBER(transient, host_unreachable)
+__DEFINE_ERROR_CATEGORY_MEMBER(transient, operation_would_block)
+__DEFINE_ERROR_CATEGORY_MEMBER(transient, resource_unavailable_try_again)
+__DEFINE_ERROR_CATEGORY_MEMBER(transient, stream_timeout)
+__DEFINE_ERROR_CATEGORY_MEMBER(transient, timed_out)
+
+// Bugs in the calling code rather than failures of the environment
+__DEFINE_ERROR_CATEGORY(programming)
+__DEFINE_ERROR_CATEGORY_MEMBER(programming, null_pointer)
+__DEFINE_ERROR_CATEGORY_MEMBER(programming, inaccessible_non_null_pointer)
+__DEFINE_ERROR_CATEGORY_MEMBER(programming, index_out_of_bounds)
+__DEFINE_ERROR_CATEGORY_MEMBER(programming, invalid_argument)
+__DEFINE_ERROR_CATEGORY_MEMBER(programming, argument_out_of_domain)
+
+// Failures which never go away by retrying. A type which is both
+// transient and permanent is not retried, so types can be taken out of
+// the transient category by adding them here, in
+// user_defined_categories.h.
+__DEFINE_ERROR_CATEGORY(permanent)
+__DEFINE_ERROR_CATEGORY_MEMBER(permanent, argument_list_too_long)
+__DEFINE_ERROR_CATEGORY_MEMBER(permanent, bad_address)
+__DEFINE_ERROR_CATEGORY_MEMBER(permanent, executable_format_error)
+__DEFINE_ERROR_CATEGORY_MEMBER(permanent, function_not_supported)
+__DEFINE_ERROR_CATEGORY_MEMBER(permanent, invalid_argument)
+__DEFINE_ERROR_CATEGORY_MEMBER(permanent, not_supported)
+__DEFINE_ERROR_CATEGORY_MEMBER(permanent, operation_not_permitted)
+__DEFINE_ERROR_CATEGORY_MEMBER(permanent, operation_not_supported)
+__DEFINE_ERROR_CATEGORY_MEMBER(permanent, permission_denied)
+__DEFINE_ERROR_CATEGORY_MEMBER(permanent, protocol_not_supported)
+__DEFINE_ERROR_CATEGORY_MEMBER(permanent, read_only_file_system)
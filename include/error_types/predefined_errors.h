@@ -26,6 +26,13 @@ SOFTWARE.
 #error __DEFINE_ERROR_T should have been defined, before including this header.
 #endif
 
+// __DEFINE_ERROR_TRAITS is optional, the includers which only list the
+// types don't need to define it.
+#ifndef __DEFINE_ERROR_TRAITS
+#define __DEFINE_ERROR_TRAITS(...)
+#define __CPP_ERRORS_UNDEF_TRAITS
+#endif
+
 __DEFINE_ERROR_T(generic_error)
 __DEFINE_ERROR_T(null_pointer)
 __DEFINE_ERROR_T(inaccessible_non_null_pointer)
@@ -113,3 +120,28 @@ __DEFINE_ERROR_T(too_many_links)
 __DEFINE_ERROR_T(too_many_symbolic_link_levels)
 __DEFINE_ERROR_T(value_too_large)
 __DEFINE_ERROR_T(wrong_protocol_type)
+
+// Compile-time policies of some of the types above, used by the
+// make_error<type> and append<type> functions. The arguments are the
+// message size limit, whether the message is stored at all and whether
+// the location of the caller is captured. Types without an entry use
+// default_error_message_size, store the message and skip the location.
+
+// Programming errors, where the location matters more than the message
+__DEFINE_ERROR_TRAITS(null_pointer, 256, true, true)
+__DEFINE_ERROR_TRAITS(inaccessible_non_null_pointer, 256, true, true)
+__DEFINE_ERROR_TRAITS(index_out_of_bounds, 256, true, true)
+
+// Frequent, short-lived conditions which rarely need a long message
+__DEFINE_ERROR_TRAITS(interrupted, 64, true, false)
+__DEFINE_ERROR_TRAITS(operation_would_block, 64, true, false)
+__DEFINE_ERROR_TRAITS(resource_unavailable_try_again, 64, true, false)
+__DEFINE_ERROR_TRAITS(timed_out, 128, true, false)
+
+// Formatting a message is the last thing to do when memory runs out
+__DEFINE_ERROR_TRAITS(not_enough_memory, 0, false, false)
+
+#ifdef __CPP_ERRORS_UNDEF_TRAITS
+#undef __DEFINE_ERROR_TRAITS
+#undef __CPP_ERRORS_UNDEF_TRAITS
+#endif
@@ -0,0 +1,45 @@
+/*
+MIT License
+
+Copyright (c) 2022 Danis Ozdemir
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// Any new categories can be defined via __DEFINE_ERROR_CATEGORY and
+// filled via __DEFINE_ERROR_CATEGORY_MEMBER as follows (without "//"
+// part, obviously):
+// __DEFINE_ERROR_CATEGORY(storage)
+// __DEFINE_ERROR_CATEGORY_MEMBER(storage, no_space_left_on_device)
+// __DEFINE_ERROR_CATEGORY_MEMBER(storage, new_user_error)
+// Members can also be added to the predefined categories, e.g.
+// __DEFINE_ERROR_CATEGORY_MEMBER(network, new_user_error)
+// The transient and permanent categories decide which types
+// results::retry retries, see errors::retryable_types:
+// __DEFINE_ERROR_CATEGORY_MEMBER(transient, new_user_error)
+// __DEFINE_ERROR_CATEGORY_MEMBER(permanent, connection_reset)
+// Please notice that the definition lines should not end with semicolon (';').
+
+#ifndef __DEFINE_ERROR_CATEGORY
+#error __DEFINE_ERROR_CATEGORY should have been defined, before including this header.
+#endif
+
+#ifndef __DEFINE_ERROR_CATEGORY_MEMBER
+#error __DEFINE_ERROR_CATEGORY_MEMBER should have been defined, before including this header.
+#endif
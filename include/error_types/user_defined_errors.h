@@ -26,7 +26,26 @@ SOFTWARE.
 // __DEFINE_ERROR_T macro as follows (without "//" part, obviously):
 // __DEFINE_ERROR_T(new_user_error)
 // Please notice that the definition line should not end with semicolon (';').
+//
+// The compile-time policies of a type can be set via the
+// __DEFINE_ERROR_TRAITS macro, after the type is defined:
+// __DEFINE_ERROR_TRAITS(new_user_error, 128, true, false)
+// The arguments are the message size limit, whether the message is
+// stored at all and whether the location of the caller is captured.
+// They're used by the make_error<type> and append<type> functions.
 
 #ifndef __DEFINE_ERROR_T
 #error __DEFINE_ERROR_T should have been defined, before including this header.
 #endif
+
+// __DEFINE_ERROR_TRAITS is optional, the includers which only list the
+// types don't need to define it.
+#ifndef __DEFINE_ERROR_TRAITS
+#define __DEFINE_ERROR_TRAITS(...)
+#define __CPP_ERRORS_UNDEF_TRAITS
+#endif
+
+#ifdef __CPP_ERRORS_UNDEF_TRAITS
+#undef __DEFINE_ERROR_TRAITS
+#undef __CPP_ERRORS_UNDEF_TRAITS
+#endif
@@ -0,0 +1,73 @@
+/*
+MIT License
+
+Copyright (c) 2022 Danis Ozdemir
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// Module interface unit of the library. Importers get the types and
+// functions of cpp_errors.h and cpp_results.h without parsing them.
+// The headers are exported wholesale, as g++ 12 can't re-export
+// declarations of the global module fragment with using-declarations.
+// Macros can't be exported from a module, so code using the
+// code_location() macro still has to include code_location.h.
+
+module;
+
+// The standard headers used by the library are included in the
+// global module fragment, so that only the library itself ends up
+// in the purview of the module.
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <time.h>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+#include <version>
+#if !defined(CPP_ERRORS_NO_PROBES) && __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#endif
+
+export module cpp_errors;
+
+export {
+#include <cpp_errors.h>
+#include <cpp_results.h>
+}
+
+// g++ 12 only emits the members of the default basic_error and the
+// function local statics of the inline functions above, and only gets
+// the instantiations of the standard containers right, when the
+// interface unit itself instantiates and uses them, so it does.
+template class errors::basic_error<std::allocator<char>>;
+
+const char* __cpp_errors_module_anchor(errors::err_type e) {
+  errors::error err = errors::make_terror(e, "%s", "");
+  err->append("%s", "");
+  return errors::c_str(err->type());
+}
@@ -0,0 +1,50 @@
+/*
+MIT License
+
+Copyright (c) 2022 Danis Ozdemir
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// A small consumer of the cpp_errors module.
+
+#include <cstdio>
+#include <new>
+
+import cpp_errors;
+
+results::result<int> half(int n) {
+  if (n % 2 != 0) {
+    return results::result<int>(errors::make_terror(errors::err_type::invalid_argument, "%d is odd", n));
+  }
+  return results::result<int>(n / 2);
+}
+
+int main() {
+  auto r = half(3);
+  if (auto err = r.error(); err) {
+    printf("%s: %s\n", errors::c_str(err->type()), err->cmessage());
+  }
+
+  r = half(4);
+  if (auto err = r.error(); !err) {
+    printf("%d\n", r.value());
+  }
+  return 0;
+}
@@ -0,0 +1,368 @@
+/*
+MIT License
+
+Copyright (c) 2022 Danis Ozdemir
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// allocations.cpp checks how many heap allocations the library makes.
+// The allocation functions are replaced below and count every call on
+// the calling thread, so a test can measure exactly the statements it
+// runs, no matter what other threads do meanwhile. The budgets are the
+// ones documented next to each check; a change that makes any of them
+// allocate more has to update them knowingly.
+//
+// malloc and friends are counted as well, except in the sanitizer
+// builds, whose runtimes own them. There only operator new is counted,
+// which is what the library allocates with.
+
+#include <gtest/gtest.h>
+#include <cpp_errors.h>
+#include <cpp_results.h>
+#include <cpp_channels.h>
+#include <cpp_frozen_errors.h>
+#include <cpp_shared_errors.h>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__SANITIZE_ADDRESS__) || defined(__SANITIZE_THREAD__)
+#define COUNT_MALLOC 0
+#else
+#define COUNT_MALLOC 1
+#endif
+
+namespace {
+struct allocation_counts {
+  std::size_t allocations = 0;
+  std::size_t bytes = 0;
+};
+
+thread_local allocation_counts thread_counts;
+
+inline void count_allocation(std::size_t size) {
+  thread_counts.allocations++;
+  thread_counts.bytes += size;
+}
+
+// The function count_allocations runs f and returns the allocations
+// it made on the calling thread.
+template <typename F>
+allocation_counts count_allocations(F&& f) {
+  allocation_counts before = thread_counts;
+  f();
+  allocation_counts after = thread_counts;
+  return allocation_counts{after.allocations - before.allocations, after.bytes - before.bytes};
+}
+
+// Messages which don't fit the inline buffer of std::string, and thus
+// cost an allocation of their own.
+const char long_message[] = "a message longer than fifteen bytes";
+const std::size_t long_message_size = sizeof(long_message);
+}  // namespace
+
+#if COUNT_MALLOC
+extern "C" {
+void* __libc_malloc(std::size_t size);
+void* __libc_calloc(std::size_t count, std::size_t size);
+void* __libc_realloc(void* p, std::size_t size);
+void __libc_free(void* p);
+
+void* malloc(std::size_t size) {
+  count_allocation(size);
+  return __libc_malloc(size);
+}
+
+void* calloc(std::size_t count, std::size_t size) {
+  count_allocation(count * size);
+  return __libc_calloc(count, size);
+}
+
+void* realloc(void* p, std::size_t size) {
+  count_allocation(size);
+  return __libc_realloc(p, size);
+}
+
+void free(void* p) { __libc_free(p); }
+}
+#endif
+
+__attribute__((noinline)) void* operator new(std::size_t size) {
+#if !COUNT_MALLOC
+  count_allocation(size);
+#endif
+  void* p = malloc(size ? size : 1);
+  if (p == nullptr) {
+#if defined(__cpp_exceptions)
+    throw std::bad_alloc();
+#else
+    abort();
+#endif
+  }
+  return p;
+}
+
+__attribute__((noinline)) void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+#if !COUNT_MALLOC
+  count_allocation(size);
+#endif
+  return malloc(size ? size : 1);
+}
+
+__attribute__((noinline)) void operator delete(void* p) noexcept { free(p); }
+
+__attribute__((noinline)) void operator delete(void* p, std::size_t) noexcept { free(p); }
+
+namespace {
+__attribute__((noinline)) results::result<int> succeed(int value) { return results::result<int>(std::move(value)); }
+
+__attribute__((noinline)) results::result<std::string> succeed(std::string&& value) {
+  return results::result<std::string>(std::move(value));
+}
+
+__attribute__((noinline)) results::result_pair<int> succeed_pair(int value) {
+  return results::result_pair<int>(std::move(value));
+}
+
+__attribute__((noinline)) results::result_pair<std::string> succeed_pair(std::string&& value) {
+  return results::result_pair<std::string>(std::move(value));
+}
+}  // namespace
+
+// Returning and consuming a successful result never allocates. Values
+// are moved through, so a string keeps its buffer.
+TEST(TestAllocations, TestSuccessfulResults) {
+  allocation_counts counts = count_allocations([] {
+    results::result<int> r = succeed(42);
+    ASSERT_EQ(r.error(), nullptr);
+    EXPECT_EQ(r.value(), 42);
+  });
+  EXPECT_EQ(counts.allocations, 0u);
+
+  std::string value(long_message);
+  counts = count_allocations([&value] {
+    results::result<std::string> r = succeed(std::move(value));
+    ASSERT_EQ(r.error(), nullptr);
+    value = r.value();
+  });
+  EXPECT_EQ(counts.allocations, 0u);
+  EXPECT_EQ(value, long_message);
+
+  counts = count_allocations([] {
+    auto [v, err] = succeed_pair(42);
+    ASSERT_EQ(err, nullptr);
+    EXPECT_EQ(v, 42);
+  });
+  EXPECT_EQ(counts.allocations, 0u);
+
+  counts = count_allocations([&value] {
+    auto [v, err] = succeed_pair(std::move(value));
+    ASSERT_EQ(err, nullptr);
+    value = std::move(v);
+  });
+  EXPECT_EQ(counts.allocations, 0u);
+  EXPECT_EQ(value, long_message);
+}
+
+// Every make_*error allocates the error, the vector of its couples with
+// room for one couple, and the message, unless it fits the inline
+// buffer of std::string. The very first one in the process also creates
+// the preallocated not_enough_memory error, which is left out here.
+TEST(TestAllocations, TestMakeError) {
+  const std::size_t error_bytes = sizeof(errors::__error) + sizeof(errors::error_couple);
+  errors::error err = errors::make_error("warm up");
+
+  allocation_counts counts = count_allocations([&err] { err = errors::make_error("%s", long_message); });
+  EXPECT_EQ(counts.allocations, 3u);
+  EXPECT_EQ(counts.bytes, error_bytes + long_message_size);
+
+  counts = count_allocations([&err] { err = errors::make_serror(512, "%s", long_message); });
+  EXPECT_EQ(counts.allocations, 3u);
+  EXPECT_EQ(counts.bytes, error_bytes + long_message_size);
+
+  counts = count_allocations([&err] { err = errors::make_terror(errors::err_type::io_error, "%s", long_message); });
+  EXPECT_EQ(counts.allocations, 3u);
+  EXPECT_EQ(counts.bytes, error_bytes + long_message_size);
+
+  counts = count_allocations(
+      [&err] { err = errors::make_tserror(errors::err_type::io_error, 512, "%s", long_message); });
+  EXPECT_EQ(counts.allocations, 3u);
+  EXPECT_EQ(counts.bytes, error_bytes + long_message_size);
+
+  counts = count_allocations([&err] { err = errors::make_error<errors::err_type::timed_out>("%s", long_message); });
+  EXPECT_EQ(counts.allocations, 3u);
+  EXPECT_EQ(counts.bytes, error_bytes + long_message_size);
+
+  counts = count_allocations([&err] { err = errors::make_error("short"); });
+  EXPECT_EQ(counts.allocations, 2u);
+  EXPECT_EQ(counts.bytes, error_bytes);
+
+  // Messages which don't fit the stack buffer are formatted straight
+  // into their string, still a single allocation.
+  const std::string huge(1000, 'x');
+  counts = count_allocations([&err, &huge] { err = errors::make_error("%s", huge.c_str()); });
+  EXPECT_EQ(counts.allocations, 3u);
+  EXPECT_EQ(counts.bytes, error_bytes + huge.size() + 1);
+
+  // Freeing the whole chain doesn't allocate.
+  counts = count_allocations([&err] { err = nullptr; });
+  EXPECT_EQ(counts.allocations, 0u);
+}
+
+// Every append allocates its message, unless it fits the inline buffer
+// of std::string, plus the grown couple vector when it's full, i.e. when
+// the chain has 1, 2, 4, 8... couples.
+TEST(TestAllocations, TestAppend) {
+  errors::error err = errors::make_error("%s", long_message);
+
+  allocation_counts counts = count_allocations([&err] { err->append("%s", long_message); });
+  EXPECT_EQ(counts.allocations, 2u);
+  EXPECT_EQ(counts.bytes, 2 * sizeof(errors::error_couple) + long_message_size);
+
+  counts = count_allocations([&err] { err->sappend(512, "%s", long_message); });
+  EXPECT_EQ(counts.allocations, 2u);
+  EXPECT_EQ(counts.bytes, 4 * sizeof(errors::error_couple) + long_message_size);
+
+  counts = count_allocations([&err] { err->tappend(errors::err_type::io_error, "%s", long_message); });
+  EXPECT_EQ(counts.allocations, 1u);
+  EXPECT_EQ(counts.bytes, long_message_size);
+
+  counts = count_allocations([&err] { err->tsappend(errors::err_type::io_error, 512, "%s", long_message); });
+  EXPECT_EQ(counts.allocations, 2u);
+
+  counts = count_allocations([&err] { err->append<errors::err_type::timed_out>("%s", long_message); });
+  EXPECT_EQ(counts.allocations, 1u);
+
+  counts = count_allocations([&err] { err->append("short"); });
+  EXPECT_EQ(counts.allocations, 0u);
+
+  // A coalesced duplicate allocates nothing.
+  err->coalesce_duplicates();
+  counts = count_allocations([&err] { err->append("%s", long_message); });
+  EXPECT_EQ(counts.allocations, 1u);
+  counts = count_allocations([&err] { err->append("%s", long_message); });
+  EXPECT_EQ(counts.allocations, 0u);
+}
+
+// Freezing an error and cloning a frozen error allocate one block each,
+// whatever the length of the chain.
+TEST(TestAllocations, TestFrozenErrors) {
+  errors::error err = errors::make_error("%s", long_message);
+  for (int i = 0; i < 15; i++) {
+    err->append("%s %d", long_message, i);
+  }
+
+  errors::frozen_error frozen;
+  allocation_counts counts = count_allocations([&err, &frozen] { frozen = errors::frozen_error(err); });
+  EXPECT_EQ(counts.allocations, 1u);
+  EXPECT_EQ(counts.bytes, frozen.size_bytes());
+
+  errors::frozen_error clone;
+  counts = count_allocations([&frozen, &clone] { clone = frozen.clone(); });
+  EXPECT_EQ(counts.allocations, 1u);
+  EXPECT_EQ(counts.bytes, frozen.size_bytes());
+  EXPECT_EQ(clone.couples().size(), 16u);
+}
+
+// Sharing an error and handing it back from its only owner don't
+// allocate, the count is kept by the error itself.
+TEST(TestAllocations, TestSharedErrors) {
+  errors::error err = errors::make_error("%s", long_message);
+  errors::shared_error shared;
+  allocation_counts counts = count_allocations([&err, &shared] {
+    shared = errors::shared_error(std::move(err));
+    errors::shared_error copy = shared;
+  });
+  EXPECT_EQ(counts.allocations, 0u);
+
+  counts = count_allocations([&err, &shared] { err = std::move(shared).to_error(); });
+  EXPECT_EQ(counts.allocations, 0u);
+  EXPECT_EQ(err->message(), long_message);
+}
+
+// Failed results cost exactly what their error costs.
+TEST(TestAllocations, TestFailedResults) {
+  errors::make_error("warm up");
+  allocation_counts counts = count_allocations([] {
+    results::result<int> r(errors::make_error("%s", long_message));
+    EXPECT_NE(r.error(), nullptr);
+  });
+  EXPECT_EQ(counts.allocations, 3u);
+
+  counts = count_allocations([] {
+    results::result_pair<int> r(errors::make_error("%s", long_message));
+    EXPECT_NE(r.second, nullptr);
+  });
+  EXPECT_EQ(counts.allocations, 3u);
+}
+
+// Each thread checks its own budgets while the others hand errors and
+// results to each other, sharing errors through shared_error and
+// channels. The sanitizer builds run this to catch races and leaks.
+TEST(TestAllocations, TestStress) {
+  const int thread_count = 4;
+  const int iterations = 2000;
+  results::spsc_channel<int, 64> channels[thread_count];
+  errors::shared_error shared(errors::make_error("%s", long_message));
+  std::vector<std::thread> threads;
+  std::vector<int> failures(thread_count, 0);
+
+  for (int t = 0; t < thread_count; t++) {
+    threads.emplace_back([&, t] {
+      results::spsc_channel<int, 64>& out = channels[t];
+      results::spsc_channel<int, 64>& in = channels[(t + 1) % thread_count];
+      int& thread_failures = failures[t];
+
+      std::thread consumer([&in] {
+        while (auto r = in.pop()) {
+          if (auto err = r->error(); err) {
+            break;
+          }
+        }
+      });
+
+      for (int i = 0; i < iterations; i++) {
+        allocation_counts counts = count_allocations([&] {
+          errors::error err = errors::make_error("iteration %d: %s", i, long_message);
+          err->append("%s", long_message);
+        });
+        thread_failures += counts.allocations != 5;
+
+        errors::shared_error copy = shared;
+        thread_failures += copy.use_count() < 2;
+        thread_failures += !errors::is(copy, errors::err_type::generic_error);
+
+        counts = count_allocations([&out, i] { out.push(results::result<int>(int(i))); });
+        thread_failures += counts.allocations != 0;
+      }
+      out.close(errors::make_error("thread %d is done", t));
+      consumer.join();
+    });
+  }
+
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  for (int t = 0; t < thread_count; t++) {
+    EXPECT_EQ(failures[t], 0) << "thread " << t;
+  }
+}
@@ -0,0 +1,128 @@
+/*
+MIT License
+
+Copyright (c) 2022 Danis Ozdemir
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// probes.cpp checks the USDT probes of the library. It's built with
+// stub/sys/sdt.h ahead of the system headers, so the probes are
+// compiled in even where <sys/sdt.h> isn't installed, and each probe
+// fired is recorded with its arguments instead of being left for a
+// tracer. tests.cpp checks the notes of the real probes, when it can.
+
+#include <gtest/gtest.h>
+#include <cpp_errors.h>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <string>
+
+#ifndef __CPP_ERRORS_PROBES
+#error The probes should be compiled in with the stub <sys/sdt.h>
+#endif
+
+namespace {
+// When set, every allocation made through operator new fails.
+std::atomic<bool> fail_allocations{false};
+
+// The function fired returns the i-th probe fired since the last reset,
+// as "provider:name(arguments)".
+std::string fired(std::size_t i) {
+  if (i >= sdt_stub::probe_count) {
+    return "none";
+  }
+  const sdt_stub::probe& p = sdt_stub::probes[i];
+  std::string out = std::string(p.provider) + ":" + p.name + "(";
+  for (std::size_t a = 0; a < p.argument_count; a++) {
+    out += a > 0 ? ", " : "";
+    out += p.arguments[a];
+  }
+  return out + ")";
+}
+
+std::string type_of(errors::err_type type) { return std::to_string(static_cast<int>(type)); }
+}  // namespace
+
+void* operator new(std::size_t size) {
+  void* p = fail_allocations ? nullptr : malloc(size ? size : 1);
+  if (p == nullptr) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+  return fail_allocations ? nullptr : malloc(size ? size : 1);
+}
+
+void operator delete(void* p) noexcept { free(p); }
+
+void operator delete(void* p, std::size_t) noexcept { free(p); }
+
+TEST(TestProbes, TestCreateAppendDestroy) {
+  sdt_stub::probe_count = 0;
+  errors::error err = errors::make_terror(errors::err_type::io_error, "read failed: %s", "/tmp/x");
+  ASSERT_EQ(sdt_stub::probe_count, 1u);
+  EXPECT_EQ(fired(0), "cpp_errors:error_create(" + type_of(errors::err_type::io_error) +
+                          ", read failed: /tmp/x, NULL, NULL, 0)");
+
+  int line = __LINE__ + 1;
+  err->append<errors::err_type::null_pointer>("%s is null", "config");
+  ASSERT_EQ(sdt_stub::probe_count, 2u);
+  EXPECT_EQ(fired(1), "cpp_errors:error_append(" + type_of(errors::err_type::null_pointer) + ", config is null, " +
+                          __FILE__ + ", " + __func__ + ", " + std::to_string(line) + ")");
+
+  err->append("%s", "without a location");
+  EXPECT_EQ(fired(2), "cpp_errors:error_append(" + type_of(errors::err_type::generic_error) +
+                          ", without a location, NULL, NULL, 0)");
+
+  err = nullptr;
+  ASSERT_EQ(sdt_stub::probe_count, 4u);
+  EXPECT_EQ(fired(3), "cpp_errors:error_destroy(" + type_of(errors::err_type::io_error) + ", read failed: /tmp/x, 3)");
+}
+
+TEST(TestProbes, TestMovedFrom) {
+  errors::error err = errors::make_error("%s", "moved away");
+  errors::__error taken(std::move(*err));
+
+  // An error whose couples were moved away reports type -1 and no
+  // message.
+  sdt_stub::probe_count = 0;
+  err = nullptr;
+  ASSERT_EQ(sdt_stub::probe_count, 1u);
+  EXPECT_EQ(fired(0), "cpp_errors:error_destroy(-1, NULL, 0)");
+}
+
+TEST(TestProbes, TestOutOfMemory) {
+  errors::error warm_up = errors::make_error("warm up");
+
+  sdt_stub::probe_count = 0;
+  fail_allocations = true;
+  errors::error err = errors::make_error("%s", "lost");
+  fail_allocations = false;
+  ASSERT_TRUE(err->preallocated());
+  ASSERT_EQ(sdt_stub::probe_count, 1u);
+  EXPECT_EQ(fired(0), "cpp_errors:out_of_memory()");
+
+  // The preallocated error is never freed, so it fires no error_destroy.
+  err = nullptr;
+  EXPECT_EQ(sdt_stub::probe_count, 1u);
+}
@@ -0,0 +1,65 @@
+/*
+MIT License
+
+Copyright (c) 2022 Danis Ozdemir
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// static_initializers.cpp is never run. It includes every header and
+// uses the library the way a typical translation unit does, and the
+// Makefile checks that its object file has no static initializer, i.e.
+// no _GLOBAL__sub_I_ function. Including the headers must not add work
+// to the startup of a program, nor to every translation unit.
+
+#include <code_location.h>
+#include <cpp_channels.h>
+#include <cpp_errors.h>
+#include <cpp_errors_pmr.h>
+#include <cpp_errors_render.h>
+#include <cpp_frozen_errors.h>
+#include <cpp_results.h>
+#include <cpp_retry.h>
+#include <cpp_shared_errors.h>
+#include <string>
+#include <utility>
+
+errors::error check(int n) {
+  if (n < 0) {
+    return errors::make_terror(errors::err_type::invalid_argument, "%d is negative", n);
+  }
+  return nullptr;
+}
+
+results::result<int> twice(int n) {
+  if (auto err = check(n); err) {
+    err->add_field("n", n);
+    return results::result<int>(std::move(err));
+  }
+  return results::result<int>(n * 2);
+}
+
+std::string describe(std::pmr::memory_resource* resource, int n) {
+  errors::shared_error shared(errors::make_error<errors::err_type::timed_out>("no reply from %d", n));
+  errors::frozen_error frozen(*shared);
+  errors::pmr::error err = errors::pmr::make_error(resource, "%s", frozen.message().data());
+  std::string out;
+  errors::render_to(std::back_inserter(out), *err);
+  return out;
+}
@@ -0,0 +1,69 @@
+/*
+MIT License
+
+Copyright (c) 2022 Danis Ozdemir
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// A stand-in for <sys/sdt.h>, used by the probes test. Instead of
+// leaving notes for a tracer, the probe macros record each probe and
+// its arguments, formatted as text, so that the test can assert them.
+// Recording never allocates, as the out_of_memory probe fires while
+// allocations fail.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdio>
+
+namespace sdt_stub {
+struct probe {
+  char provider[32];
+  char name[32];
+  std::size_t argument_count;
+  char arguments[5][128];
+};
+
+inline probe probes[64];
+inline std::size_t probe_count = 0;
+
+inline void format(char* out, std::size_t size, const char* s) { snprintf(out, size, "%s", s ? s : "NULL"); }
+
+template <typename T>
+inline void format(char* out, std::size_t size, T v) {
+  snprintf(out, size, "%lld", static_cast<long long>(v));
+}
+
+template <typename... Args>
+inline void record(const char* provider, const char* name, const Args&... args) {
+  if (probe_count == sizeof(probes) / sizeof(probes[0])) {
+    return;
+  }
+  probe& p = probes[probe_count++];
+  snprintf(p.provider, sizeof(p.provider), "%s", provider);
+  snprintf(p.name, sizeof(p.name), "%s", name);
+  p.argument_count = 0;
+  (format(p.arguments[p.argument_count++], sizeof(p.arguments[0]), args), ...);
+}
+}  // namespace sdt_stub
+
+#define DTRACE_PROBE(provider, name) sdt_stub::record(#provider, #name)
+#define DTRACE_PROBE3(provider, name, a1, a2, a3) sdt_stub::record(#provider, #name, a1, a2, a3)
+#define DTRACE_PROBE5(provider, name, a1, a2, a3, a4, a5) sdt_stub::record(#provider, #name, a1, a2, a3, a4, a5)
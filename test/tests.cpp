@@ -26,7 +26,73 @@ SOFTWARE.
 #include <cpp_errors.h>
 #include <code_location.h>
 #include <cpp_results.h>
+#include <cpp_channels.h>
+#include <cpp_errors_pmr.h>
+#include <cpp_errors_render.h>
+#include <cpp_frozen_errors.h>
+#include <cpp_retry.h>
+#include <cpp_shared_errors.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <new>
+#include <optional>
+#include <sstream>
 #include <string>
+#include <unistd.h>
+#include <thread>
+#include <vector>
+
+// A type whose messages don't fit in the stack buffer of basic_error.
+template <>
+struct errors::error_traits<errors::err_type::message_size_not_right> {
+  static constexpr std::size_t message_size = 4096;
+  static constexpr bool store_message = true;
+  static constexpr bool capture_location = false;
+};
+
+namespace {
+// When set, every allocation made through operator new fails.
+std::atomic<bool> fail_allocations{false};
+// When set to n, the n-th allocation from then on fails, and only that.
+// Without exceptions, only nothrow allocations are counted: the library
+// makes one before each allocation which would end the process.
+std::atomic<int> fail_allocation_at{0};
+
+bool allocation_fails(bool nothrow) {
+#if !defined(__cpp_exceptions)
+  if (!nothrow) {
+    return fail_allocations;
+  }
+#endif
+  (void)nothrow;
+  return fail_allocations || (fail_allocation_at > 0 && fail_allocation_at.fetch_sub(1) == 1);
+}
+}  // namespace
+
+__attribute__((noinline)) void* operator new(std::size_t size) {
+  void* p = allocation_fails(false) ? nullptr : malloc(size ? size : 1);
+  if (p == nullptr) {
+#if defined(__cpp_exceptions)
+    throw std::bad_alloc();
+#else
+    abort();
+#endif
+  }
+  return p;
+}
+
+__attribute__((noinline)) void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+  return allocation_fails(true) ? nullptr : malloc(size ? size : 1);
+}
+
+__attribute__((noinline)) void operator delete(void* p) noexcept { free(p); }
+
+__attribute__((noinline)) void operator delete(void* p, std::size_t) noexcept { free(p); }
 
 TEST(TestErrors, TestBasicError) {
   errors::error err;
@@ -123,6 +189,72 @@ TEST(TestErrors, TestTypedSizedAppend) {
   EXPECT_EQ(couples[1].type, errors::err_type::already_exists);
 }
 
+TEST(TestErrors, TestErrorTraits) {
+  static_assert(errors::error_traits<errors::err_type::timed_out>::message_size == 128);
+  static_assert(errors::error_traits<errors::err_type::generic_error>::message_size ==
+                errors::default_error_message_size);
+
+  const std::string host(200, 'h');
+  errors::error err = errors::make_error<errors::err_type::timed_out>("no reply from %s", host.c_str());
+  EXPECT_EQ(err->type(), errors::err_type::timed_out);
+  EXPECT_EQ(err->message(), ("no reply from " + host).substr(0, 127));
+  EXPECT_FALSE(err->couples()[0].location);
+
+  int line = __LINE__ + 1;
+  err->append<errors::err_type::null_pointer>("%s is null", "config");
+  const auto& couple = err->couples()[1];
+  EXPECT_EQ(couple.type, errors::err_type::null_pointer);
+  EXPECT_EQ(couple.message, "config is null");
+  ASSERT_TRUE(couple.location);
+  EXPECT_STREQ(couple.location.file, __FILE__);
+  EXPECT_EQ(couple.location.line, line);
+  EXPECT_STREQ(couple.location.function, __func__);
+
+  err->append<errors::err_type::not_enough_memory>("%s", "dropped");
+  EXPECT_EQ(err->couples()[2].message, "");
+
+  const std::string expected = "timed_out: " + err->message() + "\nnull_pointer: config is null [" + __FILE__ + ":" +
+                               std::to_string(line) + " - " + couple.location.function +
+                               "]\nnot_enough_memory: \n";
+  std::string str;
+  errors::render_to(std::back_inserter(str), *err);
+  EXPECT_EQ(str, expected);
+
+  char path[] = "/tmp/cpp_errors_traits_XXXXXX";
+  int fd = mkstemp(path);
+  ASSERT_GE(fd, 0);
+  unlink(path);
+  // Enough located couples to need more than one writev call.
+  static_assert(errors::render_batch_couples == 28);
+  static_assert(7 * errors::render_max_pieces_per_couple <= errors::render_batch_iovecs);
+  for (int i = 0; i < 200; i++) {
+    err->append<errors::err_type::index_out_of_bounds>("index %d", i);
+  }
+  str.clear();
+  errors::render_to(std::back_inserter(str), *err);
+  EXPECT_EQ(errors::render(fd, *err), static_cast<ssize_t>(str.size()));
+
+  std::string contents(str.size(), '\0');
+  EXPECT_EQ(pread(fd, &contents[0], contents.size(), 0), static_cast<ssize_t>(str.size()));
+  close(fd);
+  EXPECT_EQ(contents, str);
+}
+
+TEST(TestErrors, TestLargeMessageSize) {
+  static_assert(errors::error_traits<errors::err_type::message_size_not_right>::message_size == 4096);
+
+  const std::string short_message(100, 's');
+  errors::error err = errors::make_error<errors::err_type::message_size_not_right>("%s", short_message.c_str());
+  EXPECT_EQ(err->message(), short_message);
+
+  const std::string long_message(5000, 'l');
+  err->append<errors::err_type::message_size_not_right>("%s", long_message.c_str());
+  err->append<errors::err_type::message_size_not_right>("%s", long_message.c_str());
+  ASSERT_EQ(err->couples().size(), 3u);
+  EXPECT_EQ(err->couples()[1].message, long_message.substr(0, 4095));
+  EXPECT_EQ(err->couples()[2].message, long_message.substr(0, 4095));
+}
+
 TEST(TestErrors, TestErrorTypeStrings) {
   errors::error err;
   err = errors::make_error("some problem: %s", "ops");
@@ -135,6 +267,864 @@ TEST(TestErrors, TestErrorTypeStrings) {
   EXPECT_STREQ(errors::c_str((couples[2].type)), "null_pointer");
 }
 
+TEST(TestErrors, TestCoalescing) {
+  errors::error err = errors::make_error("connecting to %s", "db");
+  err->tappend(errors::err_type::connection_refused, "connecting to %s", "db");
+  err->tappend(errors::err_type::connection_refused, "connecting to %s", "db");
+  EXPECT_FALSE(err->coalescing());
+  EXPECT_EQ(err->couples().size(), 3u);
+  EXPECT_EQ(err->couples()[2].repeats, 1u);
+  EXPECT_EQ(err->couples()[2].last_seen, 0);
+
+  err = errors::make_terror(errors::err_type::connection_refused, "connecting to %s", "db");
+  EXPECT_TRUE(err->coalesce_duplicates().coalescing());
+  for (int i = 0; i < 1000; i++) {
+    err->tappend(errors::err_type::connection_refused, "connecting to %s", "db");
+  }
+  ASSERT_EQ(err->couples().size(), 1u);
+  EXPECT_EQ(err->couples()[0].repeats, 1001u);
+  EXPECT_GT(err->couples()[0].last_seen, 0);
+
+  // Only consecutive couples with the same type, message and location
+  // are coalesced.
+  err->tappend(errors::err_type::timed_out, "connecting to %s", "db");
+  err->tappend(errors::err_type::connection_refused, "connecting to %s", "db");
+  err->tappend(errors::err_type::connection_refused, "connecting to %s", "cache");
+  const std::string long_message(400, 'x');
+  err->append("%s", long_message.c_str());
+  err->append("%s", long_message.c_str());
+  for (int i = 0; i < 2; i++) {
+    err->append<errors::err_type::null_pointer>("%s is null", "config");
+  }
+  err->append<errors::err_type::null_pointer>("%s is null", "config");
+  ASSERT_EQ(err->couples().size(), 7u);
+  EXPECT_EQ(err->couples()[1].repeats, 1u);
+  EXPECT_EQ(err->couples()[2].repeats, 1u);
+  EXPECT_EQ(err->couples()[3].repeats, 1u);
+  EXPECT_EQ(err->couples()[4].repeats, 2u);
+  EXPECT_EQ(err->couples()[5].repeats, 2u);
+  EXPECT_EQ(err->couples()[6].repeats, 1u);
+  EXPECT_TRUE(errors::is(err, errors::err_type::timed_out));
+
+  err->coalesce_duplicates(false);
+  err->append<errors::err_type::null_pointer>("%s is null", "config");
+  EXPECT_EQ(err->couples().size(), 8u);
+
+  std::string str;
+  errors::render_to(std::back_inserter(str), *err);
+  EXPECT_EQ(str.substr(0, str.find('\n') + 1), "connection_refused: connecting to db (x1001)\n");
+  EXPECT_NE(str.find("generic_error: " + long_message + " (x2)\n"), std::string::npos);
+  EXPECT_NE(str.find(std::string(__func__) + "] (x2)\n"), std::string::npos);
+
+  char buffer[64];
+  EXPECT_FALSE(errors::render(buffer, sizeof(buffer), *errors::make_error("a")).truncated);
+  EXPECT_STREQ(buffer, "generic_error: a\n");
+}
+
+TEST(TestErrors, TestBudgets) {
+  errors::error err = errors::make_error("couple %d", 0);
+  err->set_budget(errors::error_budget{4, 0});
+  for (int i = 1; i < 10; i++) {
+    err->append("couple %d", i);
+  }
+  ASSERT_EQ(err->couples().size(), 4u);
+  EXPECT_EQ(err->dropped(), 6u);
+  EXPECT_EQ(err->dropped_at(), 2u);
+  EXPECT_EQ(err->couples()[1].message, "couple 1");
+  EXPECT_EQ(err->couples()[2].message, "couple 8");
+
+  std::string str;
+  errors::render_to(std::back_inserter(str), *err);
+  EXPECT_EQ(str,
+            "generic_error: couple 0\n"
+            "generic_error: couple 1\n"
+            "... 6 couples dropped\n"
+            "generic_error: couple 8\n"
+            "generic_error: couple 9\n");
+
+  // Where the couples were dropped doesn't change with the budget.
+  err = errors::make_error("couple %d", 0);
+  err->set_budget(errors::error_budget{6, 0});
+  for (int i = 1; i < 8; i++) {
+    err->append("couple %d", i);
+  }
+  err->set_budget(errors::error_budget{});
+  EXPECT_EQ(err->dropped_at(), 3u);
+  str.clear();
+  errors::render_to(std::back_inserter(str), *err);
+  EXPECT_EQ(str,
+            "generic_error: couple 0\n"
+            "generic_error: couple 1\n"
+            "generic_error: couple 2\n"
+            "... 2 couples dropped\n"
+            "generic_error: couple 5\n"
+            "generic_error: couple 6\n"
+            "generic_error: couple 7\n");
+  err->set_budget(errors::error_budget{2, 0});
+  EXPECT_EQ(err->dropped_at(), 3u);
+  EXPECT_EQ(err->dropped(), 4u);
+  EXPECT_EQ(err->couples()[2].message, "couple 2");
+  EXPECT_EQ(err->couples()[3].message, "couple 7");
+
+  // The first and the last couples always stay.
+  const std::string long_message(300, 'x');
+  err = errors::make_error("first");
+  err->append("%s", long_message.c_str());
+  err->append("%s", long_message.c_str());
+  err->set_budget(errors::error_budget{0, 100});
+  EXPECT_EQ(err->couples().size(), 2u);
+  EXPECT_EQ(err->dropped(), 1u);
+  EXPECT_EQ(err->bytes(), 2 * sizeof(errors::error_couple) + 5 + 300);
+
+  errors::set_default_budget(errors::error_budget{3, 0});
+  err = errors::make_error("limited");
+  errors::set_default_budget(errors::error_budget{});
+  EXPECT_EQ(err->budget().max_couples, 3u);
+  EXPECT_EQ(errors::make_error("unlimited")->budget().max_couples, 0u);
+
+  // Fields count towards the bytes, only couples are dropped for them.
+  err = errors::make_error("first");
+  err->append("middle");
+  err->append("last");
+  err->set_budget(errors::error_budget{0, 3 * sizeof(errors::error_couple) + 15 + sizeof(errors::error_field) - 1});
+  EXPECT_EQ(err->dropped(), 0u);
+  err->add_field("id", 42);
+  EXPECT_EQ(err->couples().size(), 2u);
+  EXPECT_EQ(err->dropped(), 1u);
+  EXPECT_EQ(err->fields().size(), 1u);
+  EXPECT_EQ(err->couples()[1].message, "last");
+}
+
+TEST(TestErrors, TestMemoryStats) {
+  // Without a soft limit or a default budget, nothing is counted.
+  errors::error_memory_stats before = errors::memory_stats();
+  errors::error uncounted = errors::make_error("not counted");
+  EXPECT_EQ(errors::memory_stats().live_errors, before.live_errors);
+  EXPECT_EQ(errors::memory_stats().live_bytes, before.live_bytes);
+
+  errors::set_soft_memory_limit(SIZE_MAX);
+  uncounted->append("still not counted");
+  EXPECT_EQ(errors::memory_stats().live_bytes, before.live_bytes);
+
+  errors::error err = errors::make_error("some problem: %s", "ops");
+  err->add_field("id", 42);
+  errors::error_memory_stats stats = errors::memory_stats();
+  EXPECT_EQ(stats.live_errors, before.live_errors + 1);
+  EXPECT_EQ(err->bytes(), sizeof(errors::error_couple) + 17 + sizeof(errors::error_field));
+  EXPECT_EQ(stats.live_bytes, before.live_bytes + err->bytes());
+
+  // Copies and moves are accounted for too.
+  errors::shared_error shared(std::move(err));
+  errors::error copy = shared.to_error();
+  EXPECT_EQ(errors::memory_stats().live_errors, before.live_errors + 2);
+  EXPECT_EQ(errors::memory_stats().live_bytes, before.live_bytes + 2 * copy->bytes());
+
+  // Beyond the soft limit, couples keep their type only.
+  errors::set_soft_memory_limit(1);
+  copy->tappend(errors::err_type::io_error, "read failed");
+  copy->append<errors::err_type::timed_out>("no reply");
+  errors::error degraded = errors::make_terror(errors::err_type::io_error, "read failed");
+  errors::set_soft_memory_limit(SIZE_MAX);
+  EXPECT_EQ(copy->couples()[1].message, "");
+  EXPECT_EQ(copy->couples()[2].message, "");
+  EXPECT_EQ(degraded->type(), errors::err_type::io_error);
+  EXPECT_EQ(degraded->message(), "");
+  stats = errors::memory_stats();
+  EXPECT_EQ(stats.degraded_couples, before.degraded_couples + 3);
+  EXPECT_EQ(stats.soft_limit, SIZE_MAX);
+
+  // Counted errors are taken out even once the accounting is off again.
+  errors::set_soft_memory_limit(0);
+  shared = nullptr;
+  copy = nullptr;
+  degraded = nullptr;
+  uncounted = nullptr;
+  stats = errors::memory_stats();
+  EXPECT_EQ(stats.live_errors, before.live_errors);
+  EXPECT_EQ(stats.live_bytes, before.live_bytes);
+}
+
+// Errors of an arena which is released without destroying them are
+// never taken out of the accounting, so it has to be off for them.
+TEST(TestErrors, TestMemoryStatsPmrArena) {
+  alignas(std::max_align_t) char buffer[4096];
+  errors::error_memory_stats before = errors::memory_stats();
+  {
+    std::pmr::monotonic_buffer_resource arena(buffer, sizeof(buffer), std::pmr::null_memory_resource());
+    errors::pmr::make_error(&arena, "some problem: %s", "ops").release();
+    arena.release();
+  }
+  EXPECT_EQ(errors::memory_stats().live_errors, before.live_errors);
+  EXPECT_EQ(errors::memory_stats().live_bytes, before.live_bytes);
+
+  errors::set_soft_memory_limit(SIZE_MAX);
+  {
+    std::pmr::monotonic_buffer_resource arena(buffer, sizeof(buffer), std::pmr::null_memory_resource());
+    errors::pmr::make_error(&arena, "some problem: %s", "ops").release();
+    arena.release();
+  }
+  errors::set_soft_memory_limit(0);
+  errors::error_memory_stats stats = errors::memory_stats();
+  EXPECT_EQ(stats.live_errors, before.live_errors + 1);
+  EXPECT_EQ(stats.live_bytes, before.live_bytes + sizeof(errors::pmr::error_couple) + 17);
+}
+
+TEST(TestErrors, TestAssignment) {
+  errors::set_soft_memory_limit(SIZE_MAX);
+  errors::error_memory_stats before = errors::memory_stats();
+
+  errors::error err = errors::make_error("some problem: %s", "ops");
+  err->add_field("id", 42);
+  errors::error other = errors::make_terror(errors::err_type::io_error, "read failed");
+  other->append("while loading %s", "config");
+
+  *other = *err;
+  EXPECT_EQ(other->couples().size(), 1u);
+  EXPECT_EQ(other->message(), "some problem: ops");
+  EXPECT_EQ(other->fields().size(), 1u);
+  EXPECT_EQ(other->bytes(), err->bytes());
+  EXPECT_FALSE(errors::is(other, errors::err_type::io_error));
+  errors::error_memory_stats stats = errors::memory_stats();
+  EXPECT_EQ(stats.live_errors, before.live_errors + 2);
+  EXPECT_EQ(stats.live_bytes, before.live_bytes + 2 * err->bytes());
+
+  // A moved from error is left without couples, fields and bytes.
+  const std::size_t bytes = err->bytes();
+  *other = errors::basic_error<std::allocator<char>>(std::move(*err));
+  EXPECT_EQ(other->bytes(), bytes);
+  EXPECT_TRUE(err->couples().empty());
+  EXPECT_TRUE(err->fields().empty());
+  EXPECT_EQ(err->bytes(), 0u);
+  stats = errors::memory_stats();
+  EXPECT_EQ(stats.live_errors, before.live_errors + 2);
+  EXPECT_EQ(stats.live_bytes, before.live_bytes + bytes);
+
+  *err = std::move(*other);
+  EXPECT_EQ(err->message(), "some problem: ops");
+  EXPECT_EQ(err->bytes(), bytes);
+  EXPECT_EQ(errors::memory_stats().live_bytes, before.live_bytes + bytes);
+
+  err = nullptr;
+  other = nullptr;
+  errors::set_soft_memory_limit(0);
+  stats = errors::memory_stats();
+  EXPECT_EQ(stats.live_errors, before.live_errors);
+  EXPECT_EQ(stats.live_bytes, before.live_bytes);
+}
+
+// A moved from error has no types and no drops left either, whether
+// it's moved by construction or by assignment.
+TEST(TestErrors, TestMovedFrom) {
+  errors::error err = errors::make_terror(errors::err_type::timed_out, "no reply");
+  err->set_budget(errors::error_budget{2, 0});
+  err->append("retrying");
+  err->append("giving up");
+  ASSERT_EQ(err->dropped(), 1u);
+
+  errors::basic_error<std::allocator<char>> moved(std::move(*err));
+  EXPECT_TRUE(errors::is(moved, errors::err_type::timed_out));
+  EXPECT_EQ(moved.dropped(), 1u);
+  EXPECT_FALSE(errors::is(err, errors::err_type::timed_out));
+  EXPECT_FALSE(errors::in_category(err, errors::error_category::transient));
+  EXPECT_FALSE(err->types().contains(errors::err_type::generic_error));
+  EXPECT_EQ(err->dropped(), 0u);
+  EXPECT_EQ(err->dropped_at(), 0u);
+  EXPECT_EQ(err->bytes(), 0u);
+
+  errors::error other = errors::make_error("other");
+  *other = std::move(moved);
+  EXPECT_TRUE(errors::is(other, errors::err_type::timed_out));
+  EXPECT_EQ(other->dropped(), 1u);
+  EXPECT_FALSE(errors::is(moved, errors::err_type::timed_out));
+  EXPECT_FALSE(errors::in_category(moved, errors::error_category::transient));
+  EXPECT_EQ(moved.dropped(), 0u);
+  EXPECT_EQ(moved.dropped_at(), 0u);
+  EXPECT_EQ(moved.bytes(), 0u);
+}
+
+TEST(TestErrors, TestCategories) {
+  static_assert(errors::types_of(errors::error_category::network).contains(errors::err_type::connection_reset));
+  static_assert(!errors::types_of(errors::error_category::network).contains(errors::err_type::io_error));
+
+  errors::error err;
+  EXPECT_FALSE(errors::is(err, errors::err_type::generic_error));
+  EXPECT_FALSE(errors::in_category(err, errors::error_category::network));
+
+  err = errors::make_terror(errors::err_type::io_error, "read failed");
+  EXPECT_TRUE(errors::is(err, errors::err_type::io_error));
+  EXPECT_FALSE(errors::is(err, errors::err_type::wrong_protocol_type));
+  EXPECT_TRUE(errors::in_category(err, errors::error_category::filesystem));
+  EXPECT_FALSE(errors::in_category(err, errors::error_category::network));
+
+  // The last type of the enum lives in the second word of the set.
+  err->tappend(errors::err_type::wrong_protocol_type, "unexpected reply");
+  err->append<errors::err_type::timed_out>("no reply");
+  EXPECT_TRUE(errors::is(err, errors::err_type::wrong_protocol_type));
+  EXPECT_TRUE(errors::in_category(*err, errors::error_category::network));
+  EXPECT_TRUE(errors::in_category(err, errors::error_category::transient));
+  EXPECT_FALSE(errors::in_category(err, errors::error_category::permission));
+
+  errors::shared_error shared(std::move(err));
+  EXPECT_TRUE(errors::is(shared, errors::err_type::timed_out));
+  EXPECT_TRUE(errors::in_category(shared, errors::error_category::network));
+  EXPECT_TRUE(errors::is(shared.to_error(), errors::err_type::io_error));
+}
+
+TEST(TestErrors, TestFields) {
+  errors::error err = errors::make_terror(errors::err_type::io_error, "read failed");
+  std::string path = "/var/lib/data/a \"quoted\" name";
+  err->add_field("request_id", 42)
+      .add_field("size", std::size_t(1) << 40)
+      .add_field("ratio", 0.5)
+      .add_field("retried", true)
+      .add_field("path", path)
+      .add_field("code", "E\n1");
+
+  auto& fields = err->fields();
+  ASSERT_EQ(fields.size(), 6u);
+  EXPECT_EQ(fields[0].kind, errors::field_kind::int64);
+  EXPECT_EQ(fields[1].kind, errors::field_kind::uint64);
+  EXPECT_EQ(fields[2].kind, errors::field_kind::float64);
+  EXPECT_EQ(fields[3].kind, errors::field_kind::boolean);
+  EXPECT_EQ(fields[4].kind, errors::field_kind::string);
+  // Long strings get truncated to fit inline.
+  EXPECT_EQ(fields[4].str(), path.substr(0, errors::error_field::short_string_size - 1));
+  // Keys are not copied.
+  EXPECT_EQ(fields[0].key, err->fields()[0].key);
+
+  std::int64_t id = 0;
+  std::uint64_t size = 0;
+  double ratio = 0;
+  bool retried = false;
+  std::string code;
+  err->visit_fields([&](const char* key, auto value) {
+    using T = decltype(value);
+    std::string k = key;
+    if constexpr (std::is_same<T, std::int64_t>::value) {
+      if (k == "request_id") id = value;
+    } else if constexpr (std::is_same<T, std::uint64_t>::value) {
+      if (k == "size") size = value;
+    } else if constexpr (std::is_same<T, double>::value) {
+      if (k == "ratio") ratio = value;
+    } else if constexpr (std::is_same<T, bool>::value) {
+      if (k == "retried") retried = value;
+    } else {
+      if (k == "code") code = std::string(value);
+    }
+  });
+  EXPECT_EQ(id, 42);
+  EXPECT_EQ(size, std::uint64_t(1) << 40);
+  EXPECT_EQ(ratio, 0.5);
+  EXPECT_TRUE(retried);
+  EXPECT_EQ(code, "E\n1");
+
+  EXPECT_EQ(err->fields_text(),
+            "request_id=42 size=1099511627776 ratio=0.5 retried=true path=\"/var/lib/data/a \\\"quoted\" code=\"E\\u000a1\"");
+  EXPECT_EQ(err->fields_json(),
+            "{\"request_id\":42,\"size\":1099511627776,\"ratio\":0.5,\"retried\":true,"
+            "\"path\":\"/var/lib/data/a \\\"quoted\",\"code\":\"E\\u000a1\"}");
+
+  // The message is not affected by the fields.
+  EXPECT_STREQ(err->cmessage(), "read failed");
+
+  errors::error plain = errors::make_error("no fields");
+  EXPECT_EQ(plain->fields_text(), "");
+  EXPECT_EQ(plain->fields_json(), "{}");
+
+  // Keys are escaped in JSON like values.
+  plain->add_field("say \"hi\"\n", 1);
+  EXPECT_EQ(plain->fields_json(), "{\"say \\\"hi\\\"\\u000a\":1}");
+
+  // Truncation never splits a UTF-8 sequence: 22 bytes and a 2-byte
+  // e acute don't fit in 23 bytes, so the whole sequence goes.
+  const std::string accented = std::string(22, 'a') + "\u00e9";
+  plain->add_field("name", accented);
+  EXPECT_EQ(plain->fields()[1].str(), std::string(22, 'a'));
+  const std::string fits = std::string(21, 'a') + "\u00e9" + "b";
+  plain->add_field("name", fits);
+  EXPECT_EQ(plain->fields()[2].str(), std::string(21, 'a') + "\u00e9");
+}
+
+TEST(TestErrors, TestRender) {
+  errors::error err = errors::make_terror(errors::err_type::io_error, "read failed: %s", "/tmp/x");
+  err->tappend(errors::err_type::timed_out, "after %d attempts", 3);
+  err->append("while loading the config");
+  const std::string expected =
+      "io_error: read failed: /tmp/x\n"
+      "timed_out: after 3 attempts\n"
+      "generic_error: while loading the config\n";
+
+  int fds[2];
+  ASSERT_EQ(pipe(fds), 0);
+  // Rendering to a file descriptor doesn't allocate.
+  fail_allocations = true;
+  ssize_t written = errors::render(fds[1], *err);
+  fail_allocations = false;
+  close(fds[1]);
+  EXPECT_EQ(written, static_cast<ssize_t>(expected.size()));
+
+  char read_buffer[256];
+  ssize_t n = read(fds[0], read_buffer, sizeof(read_buffer));
+  close(fds[0]);
+  EXPECT_EQ(std::string(read_buffer, n > 0 ? n : 0), expected);
+  EXPECT_EQ(errors::render(-1, *err), -1);
+
+  std::ostringstream os;
+  errors::render(os, *err);
+  EXPECT_EQ(os.str(), expected);
+
+  std::string str;
+  errors::render_to(std::back_inserter(str), *err);
+  EXPECT_EQ(str, expected);
+
+  char buffer[128];
+  errors::render_result result = errors::render(buffer, sizeof(buffer), *err);
+  EXPECT_FALSE(result.truncated);
+  EXPECT_EQ(result.length, expected.size());
+  EXPECT_EQ(std::string(buffer), expected);
+
+  result = errors::render(buffer, 16, *err);
+  EXPECT_TRUE(result.truncated);
+  EXPECT_EQ(result.length, 15u);
+  EXPECT_STREQ(buffer, "io_error: read ");
+
+  result = errors::render(nullptr, 0, *err);
+  EXPECT_TRUE(result.truncated);
+  EXPECT_EQ(result.length, 0u);
+}
+
+TEST(TestErrors, TestRenderDeepChain) {
+  errors::error err = errors::make_error("couple %d", 0);
+  std::string expected = "generic_error: couple 0\n";
+  for (int i = 1; i < 1000; i++) {
+    err->append("couple %d", i);
+    expected += "generic_error: couple " + std::to_string(i) + "\n";
+  }
+
+  char path[] = "/tmp/cpp_errors_render_XXXXXX";
+  int fd = mkstemp(path);
+  ASSERT_GE(fd, 0);
+  unlink(path);
+  EXPECT_EQ(errors::render(fd, *err), static_cast<ssize_t>(expected.size()));
+
+  std::string contents(expected.size() + 1, '\0');
+  EXPECT_EQ(pread(fd, &contents[0], contents.size(), 0), static_cast<ssize_t>(expected.size()));
+  close(fd);
+  contents.resize(expected.size());
+  EXPECT_EQ(contents, expected);
+}
+
+// The probes are looked up in the notes of the test binary itself. Their
+// arguments are checked by probes.cpp, with a stub <sys/sdt.h>.
+TEST(TestErrors, TestProbes) {
+#ifndef __CPP_ERRORS_PROBES
+  GTEST_SKIP() << "<sys/sdt.h> is not available, the probes are compiled out here, see tests_probes";
+#else
+  char path[4096];
+  ssize_t length = readlink("/proc/self/exe", path, sizeof(path) - 1);
+  ASSERT_GT(length, 0);
+  path[length] = '\0';
+
+  std::string command = std::string("readelf -n '") + path + "' 2>/dev/null";
+  FILE* readelf = popen(command.c_str(), "r");
+  ASSERT_NE(readelf, nullptr);
+  std::string notes;
+  char buffer[4096];
+  for (std::size_t n; (n = fread(buffer, 1, sizeof(buffer), readelf)) > 0;) {
+    notes.append(buffer, n);
+  }
+  pclose(readelf);
+  if (notes.empty()) {
+    GTEST_SKIP() << "readelf is not available";
+  }
+
+  EXPECT_NE(notes.find("Provider: cpp_errors"), std::string::npos);
+  for (const char* probe : {"error_create", "error_append", "error_destroy", "out_of_memory"}) {
+    EXPECT_NE(notes.find(std::string("Name: ") + probe + "\n"), std::string::npos) << probe;
+  }
+#endif
+}
+
+TEST(TestErrors, TestOutOfMemory) {
+  fail_allocations = true;
+  errors::error err = errors::make_error("some problem: %s", "ops");
+  errors::error other = errors::make_tserror(errors::err_type::io_error, 8, "some problem: %s", "blah");
+  fail_allocations = false;
+
+  ASSERT_NE(err, nullptr);
+  EXPECT_EQ(err.get(), other.get());
+  EXPECT_TRUE(err->preallocated());
+  EXPECT_EQ(err->type(), errors::err_type::not_enough_memory);
+  EXPECT_STREQ(err->cmessage(), "out of memory");
+
+  // The preallocated error is shared, appending to it is ignored. It
+  // stores no couple, but renders like one.
+  err->tappend(errors::err_type::already_exists, "hey there %s", "mate");
+  EXPECT_TRUE(err->couples().empty());
+  EXPECT_STREQ(err->cmessage(), "out of memory");
+  std::string rendered;
+  errors::render_to(std::back_inserter(rendered), *err);
+  EXPECT_EQ(rendered, "not_enough_memory: out of memory\n");
+
+  err = errors::make_error("some problem: %s", "ops");
+  EXPECT_FALSE(err->preallocated());
+
+#if defined(__cpp_exceptions)
+  // An append that can't get memory leaves the chain as it was.
+  fail_allocations = true;
+  err->append("%0300d", 1);
+  fail_allocations = false;
+  EXPECT_EQ(err->couples().size(), 1u);
+  EXPECT_STREQ(err->cmessage(), "some problem: ops");
+#endif
+}
+
+// Any single allocation made while creating or extending an error may
+// fail, not only all of them at once. Creating the error takes three:
+// the error, the couple vector and the message. Appending a long
+// message takes two more and adding a field one.
+TEST(TestErrors, TestOutOfMemoryMidway) {
+  const std::string long_message(400, 'x');
+  for (int n = 1; n <= 8; n++) {
+    fail_allocation_at = n;
+    errors::error err = errors::make_error("a message longer than fifteen bytes");
+    err->append("%s", long_message.c_str());
+    err->add_field("attempt", n);
+    fail_allocation_at = 0;
+
+    ASSERT_NE(err, nullptr);
+    if (n <= 3) {
+      EXPECT_TRUE(err->preallocated()) << n;
+      EXPECT_EQ(err->type(), errors::err_type::not_enough_memory);
+      continue;
+    }
+    EXPECT_FALSE(err->preallocated()) << n;
+    EXPECT_STREQ(err->cmessage(), "a message longer than fifteen bytes");
+    EXPECT_EQ(err->couples().size(), n <= 5 ? 1u : 2u) << n;
+    EXPECT_EQ(err->fields().size(), n == 6 ? 0u : 1u) << n;
+    if (n > 5) {
+      EXPECT_EQ(err->couples()[1].message, long_message);
+    }
+  }
+}
+
+// Messages are std::string with and without exceptions, and copies the
+// library makes fall back to the preallocated error.
+TEST(TestErrors, TestOutOfMemoryCopy) {
+  errors::error err = errors::make_error("a message longer than fifteen bytes");
+  std::string s = err->message();
+  const std::string& r = err->couples()[0].message;
+  EXPECT_EQ(s, r);
+
+  errors::shared_error shared(std::move(err));
+  errors::shared_error copy = shared;
+  fail_allocations = true;
+  copy.append("more");
+  errors::error owned = shared.to_error();
+  fail_allocations = false;
+
+  EXPECT_TRUE(copy->preallocated());
+  EXPECT_TRUE(owned->preallocated());
+  EXPECT_EQ(shared->message(), "a message longer than fifteen bytes");
+}
+
+// The first make_* call of an allocator creates its preallocated
+// error, so it has to work even when that call already runs out of
+// memory. The child runs in a fresh process, where no error has been
+// created yet.
+TEST(TestErrorsDeathTest, TestOutOfMemoryFirst) {
+  GTEST_FLAG_SET(death_test_style, "threadsafe");
+  EXPECT_EXIT(
+      {
+        fail_allocations = true;
+        errors::error err = errors::make_error("some problem: %s", "ops");
+        fail_allocations = false;
+        bool ok = err != nullptr && err->preallocated() && err->type() == errors::err_type::not_enough_memory &&
+                  err->message() == "out of memory" && err->couples().empty();
+
+#if defined(__cpp_exceptions)
+        std::pmr::set_default_resource(std::pmr::null_memory_resource());
+        errors::pmr::error pmr_err = errors::pmr::make_error(std::pmr::null_memory_resource(), "some problem");
+        ok = ok && pmr_err != nullptr && pmr_err->preallocated() && pmr_err->couples().empty() &&
+             pmr_err->type() == errors::err_type::not_enough_memory && pmr_err->message() == "out of memory" &&
+             strcmp(pmr_err->cmessage(), "out of memory") == 0;
+#endif
+        exit(ok ? 0 : 1);
+      },
+      testing::ExitedWithCode(0), "");
+}
+
+TEST(TestErrors, TestLongMessage) {
+  std::string long_message(3000, 'x');
+  errors::error err = errors::make_error("%s", long_message.c_str());
+  EXPECT_EQ(err->message(), long_message.substr(0, 1023));
+
+  err = errors::make_serror(4096, "%s", long_message.c_str());
+  EXPECT_EQ(err->message(), long_message);
+
+  err = errors::make_serror(0, "%s", long_message.c_str());
+  EXPECT_EQ(err->message(), "");
+}
+
+// A memory resource which keeps track of what it hands out.
+class counting_resource : public std::pmr::memory_resource {
+ public:
+  std::size_t allocations = 0;
+  std::size_t outstanding_bytes = 0;
+
+ private:
+  void* do_allocate(std::size_t bytes, std::size_t alignment) override {
+    allocations++;
+    outstanding_bytes += bytes;
+    return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+  }
+
+  void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) override {
+    outstanding_bytes -= bytes;
+    std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+  }
+
+  bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+};
+
+TEST(TestErrors, TestPmrError) {
+  counting_resource resource;
+  {
+    std::string long_message(300, 'x');
+    errors::pmr::error err = errors::pmr::make_terror(&resource, errors::err_type::io_error, "%s", long_message.c_str());
+    err->sappend(8, "hey there %s", "mate");
+    err->tappend(errors::err_type::already_exists, "some other error %s", "blah");
+
+    EXPECT_EQ(err->type(), errors::err_type::io_error);
+    EXPECT_EQ(err->message().size(), 300u);
+    EXPECT_EQ(err->get_allocator().resource(), &resource);
+
+    auto& couples = err->couples();
+    ASSERT_EQ(couples.size(), 3u);
+    EXPECT_STREQ(couples[1].message.c_str(), "hey the");
+    EXPECT_EQ(couples[2].type, errors::err_type::already_exists);
+    EXPECT_EQ(couples[2].message.get_allocator().resource(), &resource);
+
+    // The object, the couple vector and the long message at least
+    EXPECT_GE(resource.allocations, 3u);
+    EXPECT_GT(resource.outstanding_bytes, 300u);
+  }
+  EXPECT_EQ(resource.outstanding_bytes, 0u);
+}
+
+TEST(TestErrors, TestPmrArena) {
+  char buffer[4096];
+  std::pmr::monotonic_buffer_resource arena(buffer, sizeof(buffer), std::pmr::null_memory_resource());
+
+  errors::pmr::error err = errors::pmr::make_error(&arena, "some problem: %s", "ops");
+  err->append("hey there %s", "mate");
+  errors::pmr::error other = errors::pmr::make_serror(&arena, 8, "some problem: %s", "blah");
+
+  EXPECT_FALSE(err->preallocated());
+  EXPECT_STREQ(err->cmessage(), "some problem: ops");
+  EXPECT_STREQ(err->couples()[1].message.c_str(), "hey there mate");
+  EXPECT_STREQ(other->cmessage(), "some pr");
+
+  // Both errors live in the arena.
+  EXPECT_GE(reinterpret_cast<char*>(err.get()), buffer);
+  EXPECT_LT(reinterpret_cast<char*>(err.get()), buffer + sizeof(buffer));
+  EXPECT_GE(other->cmessage(), buffer);
+  EXPECT_LT(other->cmessage(), buffer + sizeof(buffer));
+
+#if defined(__cpp_exceptions)
+  // An exhausted arena degrades to the preallocated error.
+  std::string long_message(5000, 'x');
+  errors::pmr::error full = errors::pmr::make_serror(&arena, 8192, "%s", long_message.c_str());
+  EXPECT_TRUE(full->preallocated());
+  EXPECT_EQ(full->type(), errors::err_type::not_enough_memory);
+#endif
+}
+
+TEST(TestSharedErrors, TestConversions) {
+  errors::error err = errors::make_terror(errors::err_type::connection_refused, "%s", "connection pool is down");
+  err->append("while connecting to %s", "db1");
+  const char* message = err->cmessage();
+  const errors::__error* original = err.get();
+
+  errors::shared_error shared(std::move(err));
+  EXPECT_EQ(err, nullptr);
+  EXPECT_EQ(shared.use_count(), 1u);
+  EXPECT_EQ(shared->type(), errors::err_type::connection_refused);
+  // The error itself is shared, not copied.
+  EXPECT_EQ(shared.get(), original);
+  EXPECT_EQ(shared->cmessage(), message);
+
+  errors::shared_error copy = shared;
+  EXPECT_EQ(shared.use_count(), 2u);
+  EXPECT_EQ(copy.get(), shared.get());
+
+  // A shared error gets copied on its way out ...
+  errors::error owned = std::move(copy).to_error();
+  EXPECT_EQ(copy, nullptr);
+  EXPECT_EQ(shared.use_count(), 1u);
+  EXPECT_NE(owned->cmessage(), message);
+  EXPECT_STREQ(owned->cmessage(), "connection pool is down");
+  EXPECT_EQ(owned->couples().size(), 2u);
+
+  // ... while a unique one is handed over.
+  owned = std::move(shared).to_error();
+  EXPECT_EQ(shared, nullptr);
+  EXPECT_EQ(owned.get(), original);
+  EXPECT_EQ(owned->cmessage(), message);
+  EXPECT_EQ(owned->couples().size(), 2u);
+
+  errors::shared_error empty(errors::error(nullptr));
+  EXPECT_FALSE(empty);
+  EXPECT_EQ(empty.to_error(), nullptr);
+}
+
+TEST(TestSharedErrors, TestCopyOnWriteAppend) {
+  errors::shared_error shared(errors::make_error("%s", "upstream failure"));
+  errors::shared_error first = shared;
+  errors::shared_error second = shared;
+
+  first.tappend(errors::err_type::timed_out, "waiter %d gave up", 1);
+  EXPECT_NE(first.get(), shared.get());
+  EXPECT_EQ(first->couples().size(), 2u);
+  EXPECT_EQ(first->couples()[1].type, errors::err_type::timed_out);
+  EXPECT_EQ(shared->couples().size(), 1u);
+  EXPECT_EQ(second.get(), shared.get());
+  EXPECT_EQ(shared.use_count(), 2u);
+
+  second.add_field("waiter", 2);
+  EXPECT_NE(second.get(), shared.get());
+  EXPECT_EQ(second->fields().size(), 1u);
+  EXPECT_EQ(shared->fields().size(), 0u);
+
+  // first is the only owner of its copy now, it's appended in place.
+  const errors::__error* own = first.get();
+  first.append("and %s", "left");
+  EXPECT_EQ(first.get(), own);
+  EXPECT_EQ(first->couples().size(), 3u);
+}
+
+TEST(TestSharedErrors, TestFanOut) {
+  errors::shared_error shared(errors::make_terror(errors::err_type::network_down, "%s", "network is down"));
+  std::vector<std::thread> waiters;
+  std::atomic<int> matched{0};
+
+  for (int i = 0; i < 8; i++) {
+    waiters.emplace_back([shared, i, &matched]() mutable {
+      for (int j = 0; j < 1000; j++) {
+        errors::shared_error copy = shared;
+        if (j % 100 == 0) {
+          copy.append("waiter %d", i);
+        }
+        if (copy->type() == errors::err_type::network_down) {
+          matched++;
+        }
+      }
+    });
+  }
+  for (auto& waiter : waiters) {
+    waiter.join();
+  }
+
+  EXPECT_EQ(matched, 8000);
+  EXPECT_EQ(shared.use_count(), 1u);
+  EXPECT_EQ(shared->couples().size(), 1u);
+}
+
+TEST(TestSharedErrors, TestOutOfMemory) {
+  // Sharing an error doesn't allocate, ...
+  errors::error err = errors::make_error("some problem: %s", "ops");
+  fail_allocations = true;
+  errors::shared_error shared(std::move(err));
+  errors::shared_error copy = shared;
+  // ... but making a private copy to append to does.
+  copy.append("lost");
+  fail_allocations = false;
+
+  EXPECT_EQ(shared->message(), "some problem: ops");
+  EXPECT_EQ(shared.use_count(), 1u);
+  EXPECT_EQ(copy->type(), errors::err_type::not_enough_memory);
+  copy.append("ignored");
+  EXPECT_TRUE(copy->couples().empty());
+
+  errors::error owned = std::move(copy).to_error();
+  EXPECT_TRUE(owned->preallocated());
+}
+
+TEST(TestFrozenErrors, TestFreeze) {
+  errors::error err = errors::make_terror(errors::err_type::io_error, "read failed: %s", "/tmp/x");
+  err->tappend(errors::err_type::timed_out, "after %d attempts", 3);
+  err->append("");
+
+  errors::frozen_error frozen(err);
+  EXPECT_EQ(frozen.type(), errors::err_type::io_error);
+  EXPECT_EQ(frozen.message(), "read failed: /tmp/x");
+  EXPECT_STREQ(frozen.cmessage(), "read failed: /tmp/x");
+  ASSERT_EQ(frozen.couples().size(), 3u);
+  EXPECT_EQ(frozen.couples()[1].type, errors::err_type::timed_out);
+  EXPECT_EQ(frozen.couples()[1].message, "after 3 attempts");
+  EXPECT_EQ(frozen.couples()[2].message, "");
+  EXPECT_TRUE(errors::is(frozen, errors::err_type::timed_out));
+  EXPECT_TRUE(errors::in_category(frozen, errors::error_category::filesystem));
+
+  std::size_t i = 0;
+  for (const errors::frozen_couple& couple : frozen.couples()) {
+    EXPECT_EQ(couple.type, err->couples()[i].type);
+    EXPECT_EQ(couple.message, err->couples()[i].message);
+    EXPECT_EQ(couple.message.data()[couple.message.size()], '\0');
+    i++;
+  }
+  EXPECT_EQ(i, 3u);
+
+  // The iterator works with the standard algorithms.
+  typedef std::iterator_traits<errors::frozen_couples::iterator> traits;
+  static_assert(std::is_same<traits::iterator_category, std::input_iterator_tag>::value);
+  static_assert(std::is_same<traits::value_type, errors::frozen_couple>::value);
+  EXPECT_EQ(std::distance(frozen.couples().begin(), frozen.couples().end()), 3);
+  auto timed_out = std::find_if(frozen.couples().begin(), frozen.couples().end(),
+                                [](const errors::frozen_couple& c) { return c.type == errors::err_type::timed_out; });
+  EXPECT_EQ((*timed_out++).message, "after 3 attempts");
+  EXPECT_EQ((*timed_out).message, "");
+
+  // A clone is an independent copy of the same block.
+  errors::frozen_error clone = frozen.clone();
+  EXPECT_EQ(clone.size_bytes(), frozen.size_bytes());
+  EXPECT_NE(clone.cmessage(), frozen.cmessage());
+  frozen = nullptr;
+  EXPECT_EQ(clone.couples()[1].message, "after 3 attempts");
+
+  errors::error thawed = clone.to_error();
+  ASSERT_EQ(thawed->couples().size(), 3u);
+  EXPECT_EQ(thawed->couples()[0].message, "read failed: /tmp/x");
+  EXPECT_EQ(thawed->couples()[1].type, errors::err_type::timed_out);
+  thawed->append("more context");
+  EXPECT_EQ(thawed->couples().size(), 4u);
+
+  EXPECT_FALSE(errors::frozen_error(errors::error()));
+  EXPECT_EQ(errors::frozen_error().to_error(), nullptr);
+  // A moved from error has no couples, it freezes into nothing as well.
+  errors::error moved = errors::make_error("moved");
+  errors::__error taken(std::move(*moved));
+  EXPECT_FALSE(errors::frozen_error(moved));
+  EXPECT_EQ(errors::frozen_error(moved).to_error(), nullptr);
+  EXPECT_TRUE(errors::frozen_error().couples().empty());
+}
+
+TEST(TestFrozenErrors, TestOutOfMemory) {
+  errors::error err = errors::make_error("some problem");
+  errors::frozen_error frozen(err);
+
+  fail_allocations = true;
+  errors::frozen_error failed(err);
+  errors::frozen_error failed_clone = frozen.clone();
+  fail_allocations = false;
+  EXPECT_TRUE(failed.preallocated());
+  EXPECT_EQ(failed.type(), errors::err_type::not_enough_memory);
+  EXPECT_TRUE(failed_clone.preallocated());
+  EXPECT_TRUE(failed_clone.clone().preallocated());
+  EXPECT_TRUE(failed.to_error()->preallocated());
+  EXPECT_FALSE(frozen.preallocated());
+}
+
 TEST(TestResultPairs, TestIntegerResultPair) {
   auto proc = [](bool b, int&& val) -> results::result_pair<int> {
     if (b) {
@@ -364,6 +1354,365 @@ TEST(TestResults, TestCompositeResult) {
   EXPECT_DEATH(r.value(), "");
 }
 
+namespace {
+// move_counter counts how often it's moved and copied.
+struct move_counter {
+  static int moves;
+  static int copies;
+
+  std::string payload;
+
+  move_counter(std::string p = "") : payload(std::move(p)) {}
+  move_counter(move_counter&& other) noexcept : payload(std::move(other.payload)) { moves++; }
+  move_counter(const move_counter& other) : payload(other.payload) { copies++; }
+  move_counter& operator=(move_counter&& other) noexcept {
+    payload = std::move(other.payload);
+    moves++;
+    return *this;
+  }
+  move_counter& operator=(const move_counter& other) {
+    payload = other.payload;
+    copies++;
+    return *this;
+  }
+
+  static void reset() { moves = copies = 0; }
+};
+
+int move_counter::moves = 0;
+int move_counter::copies = 0;
+
+const char large_payload[] = "a payload which does not fit the inline buffer";
+}  // namespace
+
+TEST(TestResults, TestOptionalInterop) {
+  auto no_error = []() -> errors::error {
+    ADD_FAILURE() << "the error should not be created";
+    return errors::make_error("unexpected");
+  };
+
+  std::optional<move_counter> o(std::in_place, large_payload);
+  move_counter::reset();
+  fail_allocations = true;
+  results::result<move_counter> r(std::move(o), no_error);
+  std::optional<move_counter> back = std::move(r).to_optional();
+  fail_allocations = false;
+  EXPECT_EQ(move_counter::moves, 2);
+  EXPECT_EQ(move_counter::copies, 0);
+  EXPECT_EQ(back->payload, large_payload);
+
+  move_counter::reset();
+  fail_allocations = true;
+  results::result_pair<move_counter> p(std::move(back), no_error);
+  back = std::move(p).to_optional();
+  fail_allocations = false;
+  // The last move is the assignment to back.
+  EXPECT_EQ(move_counter::moves, 3);
+  EXPECT_EQ(move_counter::copies, 0);
+  EXPECT_EQ(back->payload, large_payload);
+
+  results::result<move_counter> failed(std::optional<move_counter>(), [] { return errors::make_error("missing"); });
+  EXPECT_FALSE(std::move(failed).to_optional().has_value());
+  failed = results::result<move_counter>(std::optional<move_counter>(), [] { return errors::make_error("missing"); });
+  EXPECT_STREQ(failed.error()->cmessage(), "missing");
+
+  results::result_pair<move_counter> failed_pair(std::optional<move_counter>(),
+                                                 [] { return errors::make_error("missing"); });
+  EXPECT_EQ(failed_pair.first.payload, "");
+  EXPECT_STREQ(failed_pair.second->cmessage(), "missing");
+  EXPECT_FALSE(std::move(failed_pair).to_optional().has_value());
+
+  EXPECT_DEATH(results::result<int>(std::optional<int>(), [] { return errors::error(); }), "");
+  EXPECT_DEATH(results::result_pair<int>(std::optional<int>(), [] { return errors::error(); }), "");
+}
+
+#if defined(__cpp_lib_expected)
+TEST(TestResults, TestExpectedInterop) {
+  std::expected<move_counter, errors::error> e(std::in_place, large_payload);
+  move_counter::reset();
+  fail_allocations = true;
+  results::result<move_counter> r(std::move(e));
+  std::expected<move_counter, errors::error> back = std::move(r).to_expected();
+  results::result_pair<move_counter> p(std::move(back));
+  std::expected<move_counter, errors::error> last = std::move(p).to_expected();
+  fail_allocations = false;
+  EXPECT_EQ(move_counter::moves, 4);
+  EXPECT_EQ(move_counter::copies, 0);
+  ASSERT_TRUE(last.has_value());
+  EXPECT_EQ(last->payload, large_payload);
+
+  results::result<move_counter> failed(
+      std::expected<move_counter, errors::error>(std::unexpect, errors::make_error("failed")));
+  std::expected<move_counter, errors::error> failed_back = std::move(failed).to_expected();
+  ASSERT_FALSE(failed_back.has_value());
+  EXPECT_STREQ(failed_back.error()->cmessage(), "failed");
+
+  results::result_pair<move_counter> failed_pair(std::move(failed_back));
+  EXPECT_STREQ(failed_pair.second->cmessage(), "failed");
+  failed_back = std::move(failed_pair).to_expected();
+  EXPECT_STREQ(failed_back.error()->cmessage(), "failed");
+
+  EXPECT_DEATH(results::result<int>(std::expected<int, errors::error>(std::unexpect, nullptr)), "");
+  EXPECT_DEATH(results::result_pair<int>(std::expected<int, errors::error>(std::unexpect, nullptr)), "");
+}
+#endif
+
+namespace {
+std::vector<std::chrono::nanoseconds> retry_delays;
+
+void record_delay(std::chrono::nanoseconds delay) { retry_delays.push_back(delay); }
+
+void skip_delay(std::chrono::nanoseconds) {}
+}  // namespace
+
+TEST(TestRetry, TestClassification) {
+  static_assert(errors::is_retryable(errors::err_type::timed_out));
+  static_assert(errors::is_retryable(errors::err_type::resource_unavailable_try_again));
+  static_assert(errors::is_retryable(errors::err_type::connection_reset));
+  static_assert(!errors::is_retryable(errors::err_type::permission_denied));
+  static_assert(!errors::is_retryable(errors::err_type::generic_error));
+
+  errors::error err = errors::make_terror(errors::err_type::timed_out, "no reply");
+  EXPECT_TRUE(errors::is_retryable(err));
+  err->append("while loading the config");
+  EXPECT_TRUE(errors::is_retryable(err));
+  err->tappend(errors::err_type::permission_denied, "no access");
+  EXPECT_FALSE(errors::is_retryable(err));
+  EXPECT_FALSE(errors::is_retryable(errors::make_error("unknown")));
+  EXPECT_FALSE(errors::is_retryable(errors::error()));
+}
+
+TEST(TestRetry, TestBackoff) {
+  results::retry_policy policy;
+  policy.max_attempts = 4;
+  policy.sleep = record_delay;
+  retry_delays.clear();
+
+  int calls = 0;
+  results::result<int> r = results::retry(policy, [&calls]() {
+    if (++calls < 4) {
+      return results::result<int>(errors::make_terror(errors::err_type::timed_out, "no reply %d", calls));
+    }
+    return results::result<int>(42);
+  });
+  EXPECT_EQ(r.error(), nullptr);
+  EXPECT_EQ(r.value(), 42);
+  EXPECT_EQ(calls, 4);
+
+  ASSERT_EQ(retry_delays.size(), 3u);
+  for (std::size_t i = 0; i < retry_delays.size(); i++) {
+    std::chrono::nanoseconds backoff = std::chrono::milliseconds(10 << i);
+    EXPECT_LE(retry_delays[i], backoff);
+    EXPECT_GE(retry_delays[i], backoff * 8 / 10);
+  }
+
+  policy.initial_backoff = std::chrono::milliseconds(400);
+  policy.max_attempts = 10;
+  retry_delays.clear();
+  calls = 0;
+  errors::error err = results::retry(policy, [&calls]() -> errors::error {
+    if (++calls < 5) {
+      return errors::make_terror(errors::err_type::interrupted, "interrupted");
+    }
+    return nullptr;
+  });
+  EXPECT_EQ(err, nullptr);
+  ASSERT_EQ(retry_delays.size(), 4u);
+  EXPECT_LE(retry_delays[3], policy.max_backoff);
+  EXPECT_GE(retry_delays[3], policy.max_backoff * 8 / 10);
+}
+
+TEST(TestRetry, TestGivingUp) {
+  results::retry_policy policy;
+  policy.sleep = skip_delay;
+
+  int calls = 0;
+  results::result<int> r = results::retry(policy, [&calls]() {
+    calls++;
+    return results::result<int>(errors::make_terror(errors::err_type::permission_denied, "no access"));
+  });
+  EXPECT_EQ(calls, 1);
+  errors::error err = r.error();
+  ASSERT_EQ(err->couples().size(), 2u);
+  EXPECT_EQ(err->type(), errors::err_type::permission_denied);
+  EXPECT_EQ(err->couples()[1].message, "gave up at attempt 1: the error is not retryable");
+
+  calls = 0;
+  auto [value, pair_err] = results::retry(policy, [&calls]() {
+    calls++;
+    return results::result_pair<int>(errors::make_terror(errors::err_type::timed_out, "no reply %d", calls));
+  });
+  EXPECT_EQ(calls, 3);
+  ASSERT_EQ(pair_err->couples().size(), 4u);
+  EXPECT_EQ(pair_err->couples()[0].message, "no reply 3");
+  EXPECT_EQ(pair_err->couples()[1].type, errors::err_type::timed_out);
+  EXPECT_EQ(pair_err->couples()[1].message, "attempt 1 failed: no reply 1");
+  EXPECT_EQ(pair_err->couples()[2].message, "attempt 2 failed: no reply 2");
+  EXPECT_EQ(pair_err->couples()[3].message, "gave up at attempt 3: no attempts left");
+
+  policy.deadline = std::chrono::milliseconds(1);
+  err = results::retry(policy, []() { return errors::make_terror(errors::err_type::timed_out, "no reply"); });
+  EXPECT_EQ(err->couples().back().message, "gave up at attempt 1: the deadline would pass");
+
+  policy.deadline = std::chrono::nanoseconds(0);
+  policy.retryable = [](const errors::__error& e) { return e.type() == errors::err_type::generic_error; };
+  calls = 0;
+  err = results::retry(policy, [&calls]() {
+    calls++;
+    return errors::make_error("flaky");
+  });
+  EXPECT_EQ(calls, 3);
+}
+
+TEST(TestRetry, TestBudget) {
+  results::retry_budget budget(1, 0.5);
+  results::retry_policy policy;
+  policy.sleep = skip_delay;
+  policy.budget = &budget;
+
+  auto fail = []() { return errors::make_terror(errors::err_type::timed_out, "no reply"); };
+  errors::error err = results::retry(policy, fail);
+  EXPECT_EQ(err->couples().back().message, "gave up at attempt 2: the retry budget is spent");
+  EXPECT_EQ(budget.tokens(), 0);
+
+  results::retry(policy, []() -> errors::error { return nullptr; });
+  EXPECT_EQ(budget.tokens(), 0.5);
+  results::retry(policy, []() -> errors::error { return nullptr; });
+  results::retry(policy, []() -> errors::error { return nullptr; });
+  EXPECT_EQ(budget.tokens(), 1);
+
+  // Threads retrying within one budget spend exactly its tokens.
+  results::retry_budget shared(10, 0);
+  policy.budget = &shared;
+  policy.max_attempts = 1000;
+  std::atomic<int> calls{0};
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 4; i++) {
+    threads.emplace_back([&policy, &calls, &fail] {
+      results::retry(policy, [&calls, &fail]() {
+        calls++;
+        return fail();
+      });
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(calls, 4 + 10);
+  EXPECT_EQ(shared.tokens(), 0);
+}
+
+TEST(TestChannels, TestPushPop) {
+  results::spsc_channel<int, 4> ch;
+  EXPECT_FALSE(ch.try_pop().has_value());
+
+  EXPECT_TRUE(ch.try_push(results::result<int>(1)));
+  EXPECT_TRUE(ch.try_push(results::result<int>(errors::make_error("false"))));
+  EXPECT_TRUE(ch.try_push(results::result<int>(3)));
+  EXPECT_TRUE(ch.try_push(results::result<int>(4)));
+
+  results::result<int> extra(5);
+  EXPECT_FALSE(ch.try_push(std::move(extra)));
+  EXPECT_EQ(extra.value(), 5);
+
+  auto r = ch.try_pop();
+  EXPECT_EQ(r->error(), nullptr);
+  EXPECT_EQ(r->value(), 1);
+
+  r = ch.try_pop();
+  auto e = r->error();
+  EXPECT_NE(e, nullptr);
+  EXPECT_STREQ(e->cmessage(), "false");
+
+  EXPECT_EQ(ch.try_pop()->value(), 3);
+  EXPECT_EQ(ch.try_pop()->value(), 4);
+  EXPECT_FALSE(ch.try_pop().has_value());
+}
+
+TEST(TestChannels, TestBatches) {
+  results::spsc_channel<std::string, 8> ch;
+
+  std::vector<results::result<std::string>> in;
+  for (int i = 0; i < 10; i++) {
+    in.emplace_back(std::to_string(i));
+  }
+
+  EXPECT_EQ(ch.try_push_batch(in.begin(), in.size()), 8u);
+
+  std::vector<results::result<std::string>> out;
+  EXPECT_EQ(ch.try_pop_batch(std::back_inserter(out), 5), 5u);
+  EXPECT_EQ(ch.try_push_batch(in.begin() + 8, 2), 2u);
+  EXPECT_EQ(ch.try_pop_batch(std::back_inserter(out), 10), 5u);
+
+  ASSERT_EQ(out.size(), 10u);
+  for (int i = 0; i < 10; i++) {
+    EXPECT_EQ(out[i].value(), std::to_string(i));
+  }
+}
+
+TEST(TestChannels, TestCloseWithError) {
+  results::spsc_channel<int, 4> ch;
+  ch.push(results::result<int>(7));
+  ch.close(errors::make_terror(errors::err_type::broken_pipe, "producer is gone"));
+  EXPECT_TRUE(ch.closed());
+
+  auto r = ch.pop();
+  EXPECT_EQ(r->value(), 7);
+
+  r = ch.pop();
+  ASSERT_TRUE(r.has_value());
+  auto e = r->error();
+  EXPECT_NE(e, nullptr);
+  EXPECT_EQ(e->type(), errors::err_type::broken_pipe);
+
+  EXPECT_FALSE(ch.pop().has_value());
+  EXPECT_FALSE(ch.try_pop().has_value());
+
+  results::spsc_channel<int, 4> plain;
+  plain.close();
+  EXPECT_FALSE(plain.pop().has_value());
+}
+
+template <typename WaitStrategy>
+void channel_transfer() {
+  const int count = 100000;
+  results::spsc_channel<int, 64, WaitStrategy> ch;
+
+  std::thread producer([&ch] {
+    for (int i = 0; i < count; i++) {
+      if (i % 1000 == 999) {
+        ch.push(results::result<int>(errors::make_error("%d", i)));
+      } else {
+        ch.push(results::result<int>(int(i)));
+      }
+    }
+    ch.close(errors::make_error("done"));
+  });
+
+  int expected = 0;
+  bool ordered = true;
+  while (auto r = ch.pop()) {
+    if (auto err = r->error(); err) {
+      if (expected == count) {
+        EXPECT_STREQ(err->cmessage(), "done");
+      } else {
+        ordered = ordered && std::to_string(expected) == err->message();
+      }
+    } else {
+      ordered = ordered && r->value() == expected;
+    }
+    expected++;
+  }
+  producer.join();
+
+  EXPECT_TRUE(ordered);
+  EXPECT_EQ(expected, count + 1);
+}
+
+TEST(TestChannels, TestSpinningTransfer) { channel_transfer<results::spin_wait>(); }
+
+TEST(TestChannels, TestBlockingTransfer) { channel_transfer<results::blocking_wait>(); }
+
 int main_(int argc, char** argv) {
   ::testing::InitGoogleTest(&argc, argv);
   (void)(::testing::GTEST_FLAG(death_test_style) = "threadsafe");